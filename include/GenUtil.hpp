@@ -6,6 +6,7 @@
 #include <string>
 #include <sstream>
 #include <climits>
+#include <cstdint>
 
 namespace LGenUtility
 {
@@ -68,6 +69,9 @@ namespace LGenUtility
         return dest.u;
     }
 
+    // Endian-swaps an array of 32-bit values in place, using SSSE3/AVX2 shuffles when the CPU has them.
+    void SwapEndianArray32(uint32_t* data, size_t count);
+
     inline size_t PadToBoundary(size_t original, size_t boundary)
     {
         return (original + (boundary - 1)) & ~(boundary - 1);
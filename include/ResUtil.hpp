@@ -3,25 +3,352 @@
 #include "GenUtil.hpp"
 #include "archive.h"
 #include "compression.h"
+#include "io/Compression.hpp"
 
 #include <iostream>
 #include <fstream>
 #include <filesystem>
 #include <string>
+#include <string_view>
+#include <span>
 #include <map>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <deque>
+#include <thread>
+#include <chrono>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 #include <ini.h>
 
+class SBcsvIO;
+
 namespace SResUtility
 {
+	// Read-only view of a whole file. Backed by mmap where the platform supports it,
+	// otherwise the file is read into a heap buffer.
+	class SMappedFile
+	{
+		uint8_t* mData { nullptr };
+		size_t mSize { 0 };
+		bool mMapped { false };
+
+		public:
+			SMappedFile() = default;
+			SMappedFile(const SMappedFile&) = delete;
+			SMappedFile& operator=(const SMappedFile&) = delete;
+			~SMappedFile() { Close(); }
+
+			bool Open(const char* path);
+			void Close();
+
+			const uint8_t* GetData() const { return mData; }
+			size_t GetSize() const { return mSize; }
+
+			// Lets the OS drop the pages in the given range, which are read back in if touched again.
+			// Does nothing if the file isn't mapped.
+			void Release(size_t offset, size_t size);
+	};
+
+	// Writes data to a temporary file next to path, flushes it to disk and renames it over path,
+	// so path always holds either the old contents or the new ones.
+	bool WriteFileAtomic(const std::filesystem::path& path, const uint8_t* data, size_t size);
+
+	// Case-insensitive lookup of archive files by their path from the root directory,
+	// e.g. "jmp/placement/common/objinfo". Directories are listed without "." and "..".
+	class SArchiveIndex
+	{
+		struct SPathHash
+		{
+			using is_transparent = void;
+			size_t operator()(std::string_view path) const;
+		};
+
+		struct SPathEqual
+		{
+			using is_transparent = void;
+			bool operator()(std::string_view a, std::string_view b) const;
+		};
+
+		struct SDirRange
+		{
+			uint32_t Start;
+			uint32_t Count;
+		};
+
+		std::unordered_map<std::string, GCarcfile*, SPathHash, SPathEqual> mFiles;
+		std::unordered_map<std::string, SDirRange, SPathHash, SPathEqual> mDirs;
+		// Children of every directory, each directory's stored contiguously.
+		std::vector<GCarcfile*> mChildren;
+
+		void AddDirectory(GCarchive* archive, uint32_t dirIndex, const std::string& path, uint32_t depth);
+
+		public:
+			void Build(GCarchive* archive);
+			void Clear();
+
+			GCarcfile* Find(std::string_view path) const;
+			// Pass an empty path for the root directory.
+			std::span<GCarcfile* const> GetChildren(std::string_view path) const;
+	};
+
+	class SGCResourceManager;
+
+	// A RARC archive loaded in full with SGCResourceManager::LoadArchive, along with the index
+	// its files are looked up through. The archive is only ever freed by Close, which drops the
+	// index with it, so lookups can't land on files that are already gone.
+	class SArchive
+	{
+		friend class SGCResourceManager;
+
+		GCarchive mArchive {};
+		SArchiveIndex mIndex;
+		// Set while the archive is loaded.
+		SGCResourceManager* mManager { nullptr };
+
+		// The archive's own entry for file, or null if file isn't one of its files.
+		GCarcfile* GetFile(const GCarcfile* file);
+
+		public:
+			SArchive() = default;
+			SArchive(const SArchive&) = delete;
+			SArchive& operator=(const SArchive&) = delete;
+			~SArchive() { Close(); }
+
+			void Close();
+			bool IsLoaded() const { return mManager != nullptr; }
+
+			// Files are handed out read only, their data may be shared with other archives. Write
+			// through GetWritableData or replace it with SGCResourceManager::ReplaceArchiveFileData.
+			// See SArchiveIndex for the path format.
+			const GCarcfile* Find(std::string_view path) const { return mIndex.Find(path); }
+			std::span<const GCarcfile* const> GetChildren(std::string_view path) const;
+
+			// Gives the file its own copy of its data first if it's shared, so edits never leak
+			// into other archives. Returns null if the copy fails or the file isn't in this archive.
+			uint8_t* GetWritableData(const GCarcfile* file);
+	};
+
+	// An archive's bytes, decompressed if needed, along with whatever keeps them alive.
+	struct SArchiveData
+	{
+		SMappedFile Mapping;
+		// Set when the decompressed bytes came from the archive cache.
+		SMappedFile CacheMapping;
+		// Set when the archive had to be decompressed.
+		void* Buffer { nullptr };
+
+		const uint8_t* Data { nullptr };
+		size_t Size { 0 };
+
+		~SArchiveData();
+	};
+
+	// A RARC archive that only parses its directory tables when opened. File data is copied
+	// out on first access through Find, so opening an archive for a handful of files
+	// doesn't pay for everything else in it. Open with SGCResourceManager::LoadArchiveLazy.
+	class SLazyArchive
+	{
+		friend class SGCResourceManager;
+
+		SArchiveData mData;
+		GCcontext* mContext { nullptr };
+
+		std::vector<GCarcdir> mDirs;
+		std::vector<GCarcfile> mFiles;
+		// Offset of every file's data from the start of the data section.
+		std::vector<uint32_t> mFileOffsets;
+		std::vector<bool> mMaterialized;
+		// Find and Materialize can be called from several threads at once.
+		std::mutex mMaterializeMutex;
+		size_t mFileDataOffset { 0 };
+
+		const char* mStringTable { nullptr };
+		size_t mStringTableSize { 0 };
+
+		SArchiveIndex mIndex;
+
+		bool Parse(GCcontext* context);
+		char* GetString(uint32_t offset) const;
+
+		public:
+			SLazyArchive() = default;
+			SLazyArchive(const SLazyArchive&) = delete;
+			SLazyArchive& operator=(const SLazyArchive&) = delete;
+			~SLazyArchive() { Close(); }
+
+			void Close();
+
+			// Returns the file at path with its data loaded, see SArchiveIndex for the path format.
+			GCarcfile* Find(std::string_view path);
+			// Children are returned as is; call Materialize before touching a file's data.
+			std::span<GCarcfile* const> GetChildren(std::string_view path) const { return mIndex.GetChildren(path); }
+			bool Materialize(GCarcfile* file);
+	};
+
+	enum class ESaveState : uint8_t
+	{
+		Compressing,
+		Writing,
+		Done,
+		Failed
+	};
+
+	// Safe to use from any thread. Each thread loads through a context of its own, but an
+	// archive's memory is always freed through the context it was loaded with, whichever thread
+	// lets go of it. Archives themselves aren't locked, so two threads shouldn't edit the same
+	// archive at once.
 	class SGCResourceManager
 	{
+		friend class SArchive;
+
 		bool mInitialized { false };
-		GCcontext mResManagerContext;
+		std::atomic<bool> mUseFastDecompressor { true };
+
+		// One context per thread that's used the manager, see GetContext. Contexts are never
+		// freed before the manager, since archives keep pointers to the one they were loaded with.
+		// They only carry the allocator, so other threads can free through them too.
+		std::deque<GCcontext> mContexts;
+		std::mutex mContextMutex;
+
+		// Every archive opened with LoadArchive that hasn't been closed yet, so the ones still
+		// open when the manager goes can be freed while the shared buffer maps are alive.
+		std::unordered_set<SArchive*> mArchives;
+		std::mutex mArchiveMutex;
+
+		struct SArchiveCacheEntry
+		{
+			std::shared_ptr<SArchive> Archive;
+			size_t Bytes;
+			// Used to spot archives that changed on disk since they were cached.
+			std::filesystem::file_time_type WriteTime;
+			uintmax_t FileSize;
+			std::list<std::string>::iterator LruPos;
+		};
+
+		// Archives opened with AcquireArchive, most recently used at the front of mArchiveLru.
+		std::unordered_map<std::string, SArchiveCacheEntry> mArchiveCache;
+		std::list<std::string> mArchiveLru;
+		size_t mArchiveCacheBudget { 256 * 1024 * 1024 };
+		size_t mArchiveCacheBytes { 0 };
+		uint32_t mArchiveCacheHits { 0 };
+		uint32_t mArchiveCacheMisses { 0 };
+		std::mutex mArchiveCacheMutex;
+
+		// Expects mArchiveCacheMutex to be held.
+		void EvictArchives();
+
+		struct SSharedBuffer
+		{
+			uint64_t Hash;
+			size_t Size;
+			uint32_t RefCount;
+			// Context of the archive the buffer was loaded into, the only one that can free it.
+			GCcontext* Context;
+		};
+
+		// File data that can be shared between archives, keyed by the data pointer. Only filled
+		// while mDeduplicateFiles is on; a buffer with one reference simply isn't shared yet.
+		std::unordered_map<void*, SSharedBuffer> mSharedBuffers;
+		std::unordered_multimap<uint64_t, void*> mSharedBuffersByHash;
+		size_t mDedupBytesSaved { 0 };
+		std::mutex mSharedBufferMutex;
+		std::atomic<bool> mDeduplicateFiles { false };
+
+		// Points files with the same contents as an already loaded file at that file's data.
+		void DeduplicateFiles(GCarchive* archive);
+		// Drops the file's reference to its data if it's tracked as shared and clears file->data.
+		// Returns false, leaving the file alone, if the data belongs to the file alone.
+		bool ReleaseSharedData(GCarcfile* file);
+		// Stops tracking the buffer without freeing it. Expects mSharedBufferMutex to be held.
+		void ForgetSharedBuffer(std::unordered_map<void*, SSharedBuffer>::iterator shared);
+		// Gives the file its own copy of its data if it's shared with other archives, so it can
+		// be written to in place. Files are never shared unless deduplication is on.
+		bool MakeFileDataPrivate(SArchive* archive, GCarcfile* file);
+
+		struct SSaveJob
+		{
+			std::string Path;
+			// Later saves to the same path win, even if an earlier one finishes after them.
+			uint64_t Sequence;
+			std::atomic<ESaveState> State { ESaveState::Compressing };
+			std::chrono::steady_clock::time_point FinishTime;
+			std::thread Worker;
+		};
+
+		std::list<std::unique_ptr<SSaveJob>> mSaveJobs;
+		std::mutex mSaveJobMutex;
+		std::atomic<uint64_t> mNextSaveSequence { 1 };
+		// Sequence of the last save written to each path.
+		std::unordered_map<std::string, uint64_t> mCommittedSaves;
+		std::mutex mCommitMutex;
+
+		void RunSaveJob(SSaveJob* job, std::vector<uint8_t> archiveData, ECompressionFormat format, ECompressionLevel level);
+		// Writes out a finished save unless a newer one to the same path already has been.
+		bool CommitSave(const std::string& path, uint64_t sequence, const std::vector<uint8_t>& data);
+
+		// Decompressed archives are cached here when set. Empty disables the cache.
+		std::filesystem::path mCacheDir;
+		size_t mCacheBudget { 0 };
+		std::mutex mDiskCacheMutex;
+
+		std::filesystem::path GetCachePath(const char* path, size_t size);
+		void WriteCacheEntry(const std::filesystem::path& cachePath, const uint8_t* data, size_t size);
+		// Evicts the least recently used entries until the cache fits in its budget.
+		// Expects mDiskCacheMutex to be held.
+		void TrimCache();
+
+		// The calling thread's context, created the first time it's asked for.
+		GCcontext* GetContext();
+
+		// Releases the archive's shared data and frees it, called by SArchive::Close.
+		void FreeArchive(SArchive* archive);
+
+		// Decompresses the mapped file into dst with the in-tree decoder if it's enabled, dropping
+		// the compressed pages as they're used up, otherwise with libgctools.
+		bool DecompressFile(SMappedFile& mapping, uint8_t* dst, size_t dst_size, bool yay0);
+
+		// Maps the archive at path, decompressing it or pulling it from the cache if it's compressed.
+		bool ReadArchiveData(const char* path, SArchiveData& out);
+
 		public:
-			bool LoadArchive(const char* path, GCarchive* archive);
-			bool SaveArchiveCompressed(const char* path, GCarchive* archive);
-			bool ReplaceArchiveFileData(GCarcfile* file, uint8_t* new_data, size_t new_data_size);
+			bool LoadArchive(const char* path, SArchive* archive);
+			bool LoadArchiveLazy(const char* path, SLazyArchive* archive);
+			// Returns a shared, already loaded copy of the archive at path if one is cached, otherwise
+			// loads it. The archive is freed once it's been evicted and every handle to it is gone.
+			// Don't edit archives opened this way, other users see the same files.
+			std::shared_ptr<SArchive> AcquireArchive(const char* path);
+			void SetArchiveCacheBudget(size_t budget);
+			void ClearArchiveCache();
+			void RenderArchiveCacheStats();
+			// Without a format and level, the ones picked in the options are used.
+			bool SaveArchiveCompressed(const char* path, SArchive* archive);
+			bool SaveArchiveCompressed(const char* path, SArchive* archive, ECompressionFormat format, ECompressionLevel level);
+			// Takes a copy of the archive's files and returns, the archive can be edited again straight
+			// away. Compressing and writing happen on a worker thread, see RenderSaveStatus.
+			bool SaveArchiveCompressedAsync(const char* path, SArchive* archive);
+			bool SaveArchiveCompressedAsync(const char* path, SArchive* archive, ECompressionFormat format, ECompressionLevel level);
+			bool IsSaving();
+			// Shows progress of background saves, and cleans up after the ones that have finished.
+			void RenderSaveStatus();
+			bool ReplaceArchiveFileData(SArchive* archive, const GCarcfile* file, uint8_t* new_data, size_t new_data_size);
+			// Writes the changes made to a BCSV back into the archive file it was loaded from.
+			// Only the dirty entries are copied when the layout and string table still fit,
+			// otherwise the file is rebuilt and replaced, and the BCSV is reloaded from it.
+			bool CommitBcsv(SArchive* archive, const GCarcfile* file, SBcsvIO* bcsv);
 			void Init();
+
+			void SetUseFastDecompressor(bool enabled) { mUseFastDecompressor = enabled; }
+			bool GetUseFastDecompressor() const { return mUseFastDecompressor; }
+			// Only affects archives loaded from then on.
+			void SetDeduplicateFiles(bool enabled) { mDeduplicateFiles = enabled; }
+			// Pass an empty path to turn the decompressed archive cache off.
+			void SetCacheDirectory(const std::filesystem::path& dir, size_t budget);
+
+			~SGCResourceManager();
 	};
 
 	class SOptions //any sort of options will be here
@@ -30,9 +357,20 @@ namespace SResUtility
 		
 		public:
 			std::filesystem::path mObjectDir;
+			bool mFastDecompression { true };
+			// Format and effort used when saving archives.
+			ECompressionFormat mSaveFormat { ECompressionFormat::Yay0 };
+			ECompressionLevel mSaveLevel { ECompressionLevel::Normal };
+			bool mCacheArchives { false };
+			int mCacheBudgetMB { 1024 };
+			int mArchiveCacheMB { 256 };
+			bool mDeduplicateFiles { false };
+			// Built models the renderer keeps between galaxies.
+			int mModelCacheMB { 512 };
 
 			void RenderOptionMenu();
 			void LoadOptions();
+			void ApplyCacheOptions();
 	};
 }
 
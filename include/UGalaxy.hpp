@@ -1,6 +1,13 @@
 #pragma once
 
 #include <map>
+#include <bit>
+#include <unordered_map>
+#include <unordered_set>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <atomic>
 #include <vector>
 #include <string>
 #include <glm/glm.hpp>
@@ -15,14 +22,83 @@
 #include <J3D/J3DRendering.hpp>
 #include "io/BcsvIO.hpp"
 #include "ResUtil.hpp"
+#include "UStringInterner.hpp"
+#include "UThreadPool.hpp"
+#include "UObjectDirIndex.hpp"
 
 class CGalaxyRenderer {
-	std::map<std::string, std::map<std::string, std::pair<std::vector<std::pair<std::string, glm::mat4>>, bool>>> mZones;
+	struct SSceneZone {
+		std::string Name;
+		uint32_t FirstLayer;
+		uint32_t LayerCount;
+		// Zones without a transform from the main zone's stageobjinfo aren't drawn.
+		bool Placed;
+	};
+
+	struct SSceneLayer {
+		std::string Name;
+		uint32_t FirstObject;
+		uint32_t ObjectCount;
+		bool Visible;
+	};
+
+	// Zones own contiguous ranges of layers, layers contiguous ranges of objects.
+	std::vector<SSceneZone> mZones;
+	std::vector<SSceneLayer> mLayers;
+
+	// One element per object. Models are stored by name ID, see mModelNames.
+	std::vector<uint32_t> mObjectModels;
+	// World space, with the zone's transform already applied.
+	std::vector<glm::mat4x3> mObjectTransforms;
+	std::vector<uint16_t> mObjectZones;
+	std::vector<uint16_t> mObjectLayers;
+	// One bit per object, set if its layer is visible and its zone placed.
+	std::vector<uint64_t> mObjectVisible;
 	std::map<std::string, glm::mat4> mZoneTransforms;
 	std::vector<std::shared_ptr<J3DModelInstance>> mRenderables;
 
-	std::vector<std::pair<std::string, glm::mat4>> LoadZoneLayer(GCarchive* zoneArchive, GCarcfile* layerDir, bool isMainGalaxyZone);
-	void LoadModel(std::string modelName);
+	struct SModelCacheEntry {
+		std::shared_ptr<J3DModelData> Model;
+		// Estimated memory use, CPU and GPU together.
+		size_t Bytes;
+		std::list<uint32_t>::iterator LruPos;
+	};
+
+	// Built models by name ID, kept across galaxies. Most recently used at the front of mModelLru.
+	std::unordered_map<uint32_t, SModelCacheEntry> mModelCache;
+	std::list<uint32_t> mModelLru;
+	size_t mModelCacheBytes { 0 };
+	uint32_t mModelCacheHits { 0 };
+	uint32_t mModelCacheMisses { 0 };
+
+	// Every model name seen by this renderer. Kept across galaxies so IDs stay stable.
+	UStringInterner mModelNames;
+
+	// A model file read on the load pool, waiting to be built on the render thread.
+	struct SPendingModel {
+		uint32_t ModelId;
+		// Empty if the model couldn't be found.
+		std::vector<uint8_t> Data;
+	};
+
+	std::deque<SPendingModel> mPendingModels;
+	std::mutex mPendingModelMutex;
+	std::atomic<uint32_t> mModelsInFlight { 0 };
+	// Models asked for since the last galaxy load, only touched on the render thread.
+	std::unordered_set<uint32_t> mRequestedModels;
+	UObjectDirIndex mObjectDir;
+
+	// Reads zone archives, decodes their placement and reads model files. Declared last so
+	// it's destroyed, finishing its tasks, before anything they write to.
+	UThreadPool mLoadPool;
+
+	// Queues the model's file to be read on the load pool, unless it's been asked for already.
+	void RequestModel(uint32_t modelId);
+	// Builds models from files read since the last frame, for as long as the frame budget allows.
+	void UploadPendingModels();
+	// Drops least recently used models until the cache fits in Options.mModelCacheMB.
+	void EvictModels();
+	void SetLayerVisible(uint32_t layerIndex, bool visible);
 
 public:
 	void RenderUI();
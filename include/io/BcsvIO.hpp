@@ -4,6 +4,9 @@
 #include "GenUtil.hpp"
 #include <memory>
 #include <vector>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 
 constexpr size_t JMP_HEADER_SIZE = 16;
 constexpr size_t JMP_FIELD_DEF_SIZE = 12;
@@ -11,6 +14,20 @@ constexpr uint32_t JMP_HASH_PRIME = 33554393;
 
 class SBcsvIO;
 
+// Hashes a field name the same way the game does. Usable at compile time for known field names.
+constexpr uint32_t JmpHashFieldName(std::string_view name)
+{
+	uint32_t hash = 0;
+
+	for (char c : name)
+	{
+		hash *= 0x1F;
+		hash += c;
+	}
+
+	return hash;
+}
+
 class ISerializable
 {
 public:
@@ -33,6 +50,21 @@ enum class EJmpFieldType : uint8_t
 	String
 };
 
+// Size in bytes of a field of the given type within an entry. String fields hold a
+// 4-byte offset into the string table.
+constexpr uint32_t JmpFieldTypeSize(EJmpFieldType type)
+{
+	switch (type)
+	{
+	case EJmpFieldType::Short:
+		return sizeof(uint16_t);
+	case EJmpFieldType::Byte:
+		return sizeof(uint8_t);
+	default:
+		return sizeof(uint32_t);
+	}
+}
+
 // Definition of a field making up an entry in the JMP files.
 struct SBcsvFieldInfo
 {
@@ -48,6 +80,10 @@ struct SBcsvFieldInfo
 	EJmpFieldType Type;
 };
 
+// Handle to a field resolved once per file with SBcsvIO::GetFieldHandle.
+// Stays valid until the owning SBcsvIO is reloaded or destroyed; nullptr means the field doesn't exist.
+using SBcsvFieldHandle = const SBcsvFieldInfo*;
+
 // Handles reading and writing data from the map JMP files.
 class SBcsvIO
 {
@@ -65,30 +101,66 @@ class SBcsvIO
 
 	// A vector of the fields that define the data within the JMP entries.
 	std::vector<SBcsvFieldInfo> mFields;
+	// Maps field hashes to their index in mFields.
+	std::unordered_map<uint32_t, uint32_t> mFieldLookup;
 
 	// Pointer to the data blob containing the entries in this JMP file.
 	uint8_t* mData { nullptr };
 	uint8_t* mStringTable { nullptr };
+	// Size of the string table in bytes.
+	size_t mStringTableSize { 0 };
+
+	// Our own copies of the entry data and string table. These are empty while this
+	// instance is a view, in which case mData and mStringTable point into the source buffer.
+	std::vector<uint8_t> mDataStorage;
+	std::vector<uint8_t> mStringTableStorage;
+	// Whether mData and mStringTable are borrowed from the buffer this file was loaded from.
+	bool mIsView { false };
+
+	// Offsets of the strings already in the string table, so SetString can reuse them.
+	// Built on the first SetString call.
+	std::unordered_map<std::string, uint32_t> mStringOffsets;
+	bool mStringOffsetsBuilt { false };
+
+	// Entries written to since the file was loaded or last patched.
+	std::vector<bool> mDirtyRows;
+	bool mHasDirtyRows { false };
+	// Size of the string table as loaded. It only grows when SetString adds a new string.
+	size_t mLoadedStringTableSize { 0 };
+	// Whether the entry count or layout no longer matches the file this was loaded from.
+	bool mLayoutChanged { false };
+
+	// Parses the header and field definitions from the given stream, then either copies the
+	// entry data and string table out of it or borrows them in place.
+	bool LoadInternal(bStream::CMemoryStream* stream, bool borrow);
+	// Takes ownership of the entry data and string table if they are currently borrowed,
+	// so that the source buffer is never written to.
+	void MakeWritable();
 
 	// Hashes the given field name so that the field can be found from the list of loaded instances.
-	uint32_t HashFieldName(std::string name) const;
+	uint32_t HashFieldName(std::string_view name) const;
 
 	// Returns a pointer to the field info corresponding to the given name if it exists within this JMP file,
 	// or nullptr if it does not exist.
-	const SBcsvFieldInfo* FetchJmpFieldInfo(std::string name);
+	const SBcsvFieldInfo* FetchJmpFieldInfo(std::string_view name) const;
 	// Returns a pointer to the field info corresponding to the given hash if it exists within this JMP file,
 	// or nullptr if it does not exist.
-	const SBcsvFieldInfo* FetchJmpFieldInfo(uint32_t hash);
-	// Retrieves the unsigned integer at the given offset from this JMP file's entry data.
-	uint32_t PeekU32(uint32_t offset);
-	// Retrieves the signed integer at the given offset from this JMP file's entry data.
-	int32_t PeekS32(uint32_t offset);
-	// Retrieves the float at the given offset from this JMP file's entry data.
-	float PeekF32(uint32_t offset);
-
-	bool PokeU32(uint32_t offset, uint32_t value);
-	bool PokeS32(uint32_t offset, int32_t value);
-	bool PokeF32(uint32_t offset, float value);
+	const SBcsvFieldInfo* FetchJmpFieldInfo(uint32_t hash) const;
+	// Retrieves the raw value of the given field from the given entry, read at the width of the
+	// field's type and before the bitmask is applied. Returns 0 if out of range.
+	uint32_t PeekField(uint32_t entry_index, SBcsvFieldHandle field) const;
+	// Writes the raw value of the given field in the given entry, truncated to the width of its type.
+	bool PokeField(uint32_t entry_index, SBcsvFieldHandle field, uint32_t value);
+
+	// Copies the raw value of the given field out of every entry into out, widened to 32 bits.
+	// The read width is picked once for the whole column. Returns false if the field is invalid.
+	bool GatherColumn(SBcsvFieldHandle field, uint32_t* out) const;
+
+	// Returns the null-terminated string at the given offset into the string table,
+	// or an empty string if the offset is out of range.
+	std::string_view PeekString(uint32_t offset) const;
+	// Returns the offset of the given string in the string table, appending it if it isn't there yet.
+	uint32_t AddString(std::string_view value);
 
 	// Recalculates the size of each entry by examining the fields defining the entry data.
 	uint32_t CalculateNewEntrySize();
@@ -111,13 +183,29 @@ public:
 	// true if the load succeeded, false if not.
 	bool Load(bStream::CMemoryStream* stream);
 
+	// Loads a JMP file as a read-only view of the stream's buffer instead of copying it.
+	// The buffer (e.g. the GCarcfile data it came from) must outlive this instance;
+	// the first setter call copies the data so the buffer itself is never modified.
+	bool LoadView(bStream::CMemoryStream* stream);
+
+	// Whether this instance is still borrowing the buffer it was loaded from.
+	bool IsView() const { return mIsView; }
+
+	// Resolves the given field name to a handle that can be passed to the accessors below,
+	// skipping the name hash and field lookup on every read. Returns nullptr if the field doesn't exist.
+	SBcsvFieldHandle GetFieldHandle(std::string_view field_name) const { return FetchJmpFieldInfo(field_name); }
+	// Resolves the field with the given name hash to a handle; see JmpHashFieldName.
+	SBcsvFieldHandle GetFieldHandle(uint32_t field_hash) const { return FetchJmpFieldInfo(field_hash); }
+
 	// Attempts to return the value of the given field from the given JMP entry
 	// as an unsigned int; returns 0 if the field is invalid.
-	uint32_t GetUnsignedInt(uint32_t entry_index, std::string field_name);
+	uint32_t GetUnsignedInt(uint32_t entry_index, std::string_view field_name);
+	uint32_t GetUnsignedInt(uint32_t entry_index, SBcsvFieldHandle field);
 
 	// Attempts to return the value of the given field from the given JMP entry
-	// as an signed int; returns 0 if the field is invalid.
-	int32_t GetSignedInt(uint32_t entry_index, std::string field_name);
+	// as an signed int; Short and Byte fields are sign-extended. Returns 0 if the field is invalid.
+	int32_t GetSignedInt(uint32_t entry_index, std::string_view field_name);
+	int32_t GetSignedInt(uint32_t entry_index, SBcsvFieldHandle field);
 
 	// Attempts to return the value of the given field, using the hash to look up the field.
 	// Returns 0 if invalid.
@@ -125,38 +213,84 @@ public:
 
 	// Attempts to return the value of the given field from the given JMP entry
 	// as float; returns 0.0f if the field is invalid.
-	float GetFloat(uint32_t entry_index, std::string field_name);
+	float GetFloat(uint32_t entry_index, std::string_view field_name);
+	float GetFloat(uint32_t entry_index, SBcsvFieldHandle field);
 
 	// Attempts to return the value of the given field from the given JMP entry
 	// as a boolean; returns false if the field is invalid.
-	bool GetBoolean(uint32_t entry_index, std::string field_name);
+	bool GetBoolean(uint32_t entry_index, std::string_view field_name);
+	bool GetBoolean(uint32_t entry_index, SBcsvFieldHandle field);
 
 	// Attempts to return the value of the given field from the given JMP entry
-	// as a string; returns "(null)" if the field is invalid.
-	std::string GetString(uint32_t entry_index, std::string field_name);
+	// as a string; returns "" if the field is invalid.
+	std::string GetString(uint32_t entry_index, std::string_view field_name);
+	std::string GetString(uint32_t entry_index, SBcsvFieldHandle field);
+
+	// Like GetString, but returns a view into the string table instead of a copy.
+	// The view is valid until the string table changes or this instance is destroyed.
+	std::string_view GetStringView(uint32_t entry_index, std::string_view field_name);
+	std::string_view GetStringView(uint32_t entry_index, SBcsvFieldHandle field);
+
+	// Decodes the given field for every entry at once into out, which must have room for
+	// GetEntryCount() values. Values are decoded exactly like the matching single-value accessor.
+	// Returns false and leaves out untouched if the field is invalid.
+	bool GetUnsignedIntColumn(SBcsvFieldHandle field, uint32_t* out) const;
+	bool GetSignedIntColumn(SBcsvFieldHandle field, int32_t* out) const;
+	bool GetFloatColumn(SBcsvFieldHandle field, float* out) const;
 
 /*== Output ==*/
+	// Whether any entry has been written to since the file was loaded or last patched.
+	bool IsDirty() const { return mHasDirtyRows || mLayoutChanged; }
+
+	// Whether the changes can't be patched over the original file, because the string table
+	// grew or the layout changed; Save has to rebuild the whole file instead.
+	bool NeedsResize() const { return mLayoutChanged || mStringTableSize > mLoadedStringTableSize; }
+
+	// Copies only the dirty entries over the original file in the given buffer, which must be
+	// the data this file was loaded from (e.g. its GCarcfile data). Returns false without
+	// touching the buffer if NeedsResize is true or the buffer is too small.
+	bool PatchInPlace(uint8_t* file_data, size_t file_size);
+
+
+	// Serializes the current entries into out as a complete JMP file, ready to be handed to
+	// SGCResourceManager::ReplaceArchiveFileData. The string table is rebuilt so that every
+	// string still referenced by an entry is written exactly once.
+	bool Save(std::vector<uint8_t>& out);
+
 	// Saves the current JMP data to the given stream.
-	//bool Save(std::vector<std::shared_ptr<LEntityDOMNode>> entities, bStream::CMemoryStream& stream);
+	bool Save(bStream::CMemoryStream& stream);
+
+	// Repacks the fields into the smallest entry layout their types allow, widest fields first.
+	// Fields sharing a bitfield stay together. Takes effect on the next Save.
+	void CompactLayout();
+
+	// Replaces the entries with the given entities, serialized through ISerializable, then saves
+	// the result into out. The field definitions are kept as they are.
+	bool Save(const std::vector<std::shared_ptr<ISerializable>>& entities, std::vector<uint8_t>& out);
 
 	// Writes an unsigned int to the given field in the specified JMP entry,
 	// packing into a bitfield if required.
-	bool SetUnsignedInt(uint32_t entry_index, std::string field_name, uint32_t value);
+	bool SetUnsignedInt(uint32_t entry_index, std::string_view field_name, uint32_t value);
+	bool SetUnsignedInt(uint32_t entry_index, SBcsvFieldHandle field, uint32_t value);
 
 	// Writes a signed int to the given field in the specified JMP entry, searching by name.
-	bool SetSignedInt(uint32_t entry_index, std::string field_name, int32_t value);
+	bool SetSignedInt(uint32_t entry_index, std::string_view field_name, int32_t value);
+	bool SetSignedInt(uint32_t entry_index, SBcsvFieldHandle field, int32_t value);
 
 	// Writes a signed int to the given field in the specified JMP entry, searching by hash.
 	bool SetSignedInt(uint32_t entry_index, uint32_t field_hash, int32_t value);
 
 	// Writes a float to the given field in the specified JMP entry.
-	bool SetFloat(uint32_t entry_index, std::string field_name, float value);
+	bool SetFloat(uint32_t entry_index, std::string_view field_name, float value);
+	bool SetFloat(uint32_t entry_index, SBcsvFieldHandle field, float value);
 
 	// Writes a boolean to the given field in the specified JMP entry,
 	// packing into a bitfield if required.
-	bool SetBoolean(uint32_t entry_index, std::string field_name, bool value);
+	bool SetBoolean(uint32_t entry_index, std::string_view field_name, bool value);
+	bool SetBoolean(uint32_t entry_index, SBcsvFieldHandle field, bool value);
 
-	// Writes a string to the given field in the specified JMP entry; pads the string
-	// to 32 bytes in length.
-	bool SetString(uint32_t entry_index, std::string field_name, std::string value);
+	// Writes a string to the given field in the specified JMP entry, adding it to the
+	// string table if an identical string isn't already there.
+	bool SetString(uint32_t entry_index, std::string_view field_name, std::string value);
+	bool SetString(uint32_t entry_index, SBcsvFieldHandle field, std::string value);
 };
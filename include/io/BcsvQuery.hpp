@@ -0,0 +1,99 @@
+#pragma once
+
+#include "io/BcsvIO.hpp"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A set of row indices in a BCSV file, stored as a bitmap with one bit per entry.
+class SBcsvRowSet
+{
+	std::vector<uint64_t> mWords;
+	uint32_t mRowCount { 0 };
+
+public:
+	SBcsvRowSet() = default;
+	SBcsvRowSet(uint32_t rowCount, bool set);
+
+	uint32_t GetRowCount() const { return mRowCount; }
+	std::vector<uint64_t>& GetWords() { return mWords; }
+	const std::vector<uint64_t>& GetWords() const { return mWords; }
+
+	bool Test(uint32_t row) const { return (mWords[row / 64] >> (row % 64)) & 1; }
+	void Set(uint32_t row) { mWords[row / 64] |= (1ull << (row % 64)); }
+
+	// Number of rows in the set.
+	uint32_t Count() const;
+	// Indices of the rows in the set, in ascending order.
+	std::vector<uint32_t> GetRows() const;
+
+	SBcsvRowSet& operator&=(const SBcsvRowSet& other);
+	SBcsvRowSet& operator|=(const SBcsvRowSet& other);
+};
+
+enum class EBcsvQueryOp : uint8_t
+{
+	Equal,
+	NotEqual,
+	Less,
+	LessEqual,
+	Greater,
+	GreaterEqual,
+	// Inclusive range, [min, max]
+	Between
+};
+
+// Finds the rows of a BCSV file matching a set of predicates, all of which must hold.
+// Each predicate decodes its field as a whole column and is evaluated 64 rows at a time
+// into the result bitmap, in loops simple enough for the compiler to vectorize.
+// Integer fields are compared after applying their bitmask and shift, with Short and Byte
+// fields sign-extended.
+//
+//   SBcsvQuery query;
+//   query.Where("name", EBcsvQueryOp::Equal, "Kuribo").WhereBetween("pos_y", 0.0f, 500.0f);
+//   SBcsvRowSet rows = query.Execute(ObjInfo);
+class SBcsvQuery
+{
+	enum class EValueKind : uint8_t { Int, Float, String };
+
+	struct SPredicate
+	{
+		uint32_t FieldHash;
+		EBcsvQueryOp Op;
+		EValueKind Kind;
+		int32_t Int[2];
+		float Float[2];
+		std::string String;
+	};
+
+	std::vector<SPredicate> mPredicates;
+	std::vector<std::string> mProjection;
+
+	SPredicate& AddPredicate(std::string_view field_name, EBcsvQueryOp op, EValueKind kind);
+
+	void EvaluateInt(const SPredicate& predicate, const int32_t* values, SBcsvRowSet& result) const;
+	void EvaluateFloat(const SPredicate& predicate, const float* values, SBcsvRowSet& result) const;
+	void EvaluateString(const SPredicate& predicate, SBcsvIO& bcsv, SBcsvFieldHandle field, SBcsvRowSet& result) const;
+
+public:
+	SBcsvQuery& Where(std::string_view field_name, EBcsvQueryOp op, int32_t value);
+	SBcsvQuery& Where(std::string_view field_name, EBcsvQueryOp op, float value);
+	// Strings only support Equal and NotEqual.
+	SBcsvQuery& Where(std::string_view field_name, EBcsvQueryOp op, std::string_view value);
+	SBcsvQuery& Where(std::string_view field_name, EBcsvQueryOp op, const char* value) { return Where(field_name, op, std::string_view(value)); }
+
+	SBcsvQuery& WhereBetween(std::string_view field_name, int32_t min, int32_t max);
+	SBcsvQuery& WhereBetween(std::string_view field_name, float min, float max);
+
+	// Adds a field to the projection returned by GetProjection, in order.
+	SBcsvQuery& Select(std::string_view field_name);
+	const std::vector<std::string>& GetProjection() const { return mProjection; }
+
+	// Returns the rows matching every predicate. Predicates on fields the file doesn't
+	// have match nothing.
+	SBcsvRowSet Execute(SBcsvIO& bcsv) const;
+
+	// Formats the value of the given field in the given entry as text, according to the field's type.
+	static std::string FormatField(SBcsvIO& bcsv, uint32_t entry_index, std::string_view field_name);
+};
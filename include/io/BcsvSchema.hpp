@@ -0,0 +1,128 @@
+#pragma once
+
+#include "io/BcsvIO.hpp"
+#include <algorithm>
+#include <array>
+#include <type_traits>
+#include <utility>
+
+// A field name usable as a template argument, e.g. SBcsvField<"pos_x", &SRow::PosX>.
+template<size_t N>
+struct SBcsvFieldName
+{
+	char Value[N] {};
+
+	constexpr SBcsvFieldName(const char (&name)[N]) { std::copy_n(name, N, Value); }
+	constexpr std::string_view View() const { return { Value, N - 1 }; }
+};
+
+// Binds the BCSV field with the given name to a member of a row struct.
+// The field's type is taken from the member: float, int32_t, uint32_t, bool, std::string or
+// std::string_view. Views point into the file's string table and share its lifetime.
+template<SBcsvFieldName Name, auto Member>
+struct SBcsvField
+{
+	static constexpr uint32_t Hash = JmpHashFieldName(Name.View());
+	static constexpr auto Target = Member;
+};
+
+// Decodes BCSV entries straight into a plain struct. Field names are hashed at compile time and
+// resolved against a file once with Bind, so reading rows does no string or hash work at all.
+//
+//   using SPosSchema = SBcsvSchema<SPosRow, SBcsvField<"pos_x", &SPosRow::X>, SBcsvField<"pos_y", &SPosRow::Y>>;
+//   SPosSchema schema;
+//   schema.Bind(bcsv);
+//   std::vector<SPosRow> rows = schema.ReadAll(bcsv);
+template<typename Row, typename... Fields>
+class SBcsvSchema
+{
+	std::array<SBcsvFieldHandle, sizeof...(Fields)> mHandles {};
+
+	template<auto Member>
+	using MemberType = std::remove_cvref_t<decltype(std::declval<Row&>().*Member)>;
+
+	template<typename Field>
+	static void ReadField(SBcsvIO& bcsv, uint32_t entry_index, SBcsvFieldHandle handle, Row& row)
+	{
+		using T = MemberType<Field::Target>;
+		auto& target = row.*Field::Target;
+
+		if constexpr (std::is_same_v<T, float>)
+			target = bcsv.GetFloat(entry_index, handle);
+		else if constexpr (std::is_same_v<T, int32_t>)
+			target = bcsv.GetSignedInt(entry_index, handle);
+		else if constexpr (std::is_same_v<T, uint32_t>)
+			target = bcsv.GetUnsignedInt(entry_index, handle);
+		else if constexpr (std::is_same_v<T, bool>)
+			target = bcsv.GetBoolean(entry_index, handle);
+		else if constexpr (std::is_same_v<T, std::string>)
+			target = bcsv.GetString(entry_index, handle);
+		else if constexpr (std::is_same_v<T, std::string_view>)
+			target = bcsv.GetStringView(entry_index, handle);
+		else
+			static_assert(!sizeof(T), "Unsupported BCSV schema member type!");
+	}
+
+	// Reads a whole field with the column decoders where possible, then scatters it into the rows.
+	template<typename Field>
+	static void ReadColumn(SBcsvIO& bcsv, SBcsvFieldHandle handle, std::vector<Row>& rows)
+	{
+		using T = MemberType<Field::Target>;
+
+		if constexpr (std::is_same_v<T, float> || std::is_same_v<T, int32_t> || std::is_same_v<T, uint32_t> || std::is_same_v<T, bool>)
+		{
+			using ColumnT = std::conditional_t<std::is_same_v<T, bool>, uint32_t, T>;
+			std::vector<ColumnT> column(rows.size(), ColumnT {});
+
+			if constexpr (std::is_same_v<ColumnT, float>)
+				bcsv.GetFloatColumn(handle, column.data());
+			else if constexpr (std::is_same_v<ColumnT, int32_t>)
+				bcsv.GetSignedIntColumn(handle, column.data());
+			else
+				bcsv.GetUnsignedIntColumn(handle, column.data());
+
+			for (size_t i = 0; i < rows.size(); i++)
+				rows[i].*Field::Target = (T)column[i];
+		}
+		else
+		{
+			for (size_t i = 0; i < rows.size(); i++)
+				ReadField<Field>(bcsv, (uint32_t)i, handle, rows[i]);
+		}
+	}
+
+	template<size_t... I>
+	void ReadRowImpl(SBcsvIO& bcsv, uint32_t entry_index, Row& row, std::index_sequence<I...>) const
+	{
+		(ReadField<Fields>(bcsv, entry_index, mHandles[I], row), ...);
+	}
+
+	template<size_t... I>
+	void ReadAllImpl(SBcsvIO& bcsv, std::vector<Row>& rows, std::index_sequence<I...>) const
+	{
+		(ReadColumn<Fields>(bcsv, mHandles[I], rows), ...);
+	}
+
+public:
+	// Resolves every field of the schema against the given file. Returns false if any field is
+	// missing from it; missing fields still decode, as 0 or "" like the SBcsvIO accessors.
+	bool Bind(const SBcsvIO& bcsv)
+	{
+		mHandles = { bcsv.GetFieldHandle(Fields::Hash)... };
+		return std::find(mHandles.begin(), mHandles.end(), nullptr) == mHandles.end();
+	}
+
+	// Decodes a single entry into the given row.
+	void ReadRow(SBcsvIO& bcsv, uint32_t entry_index, Row& row) const
+	{
+		ReadRowImpl(bcsv, entry_index, row, std::index_sequence_for<Fields...>{});
+	}
+
+	// Decodes every entry in the file, one field at a time.
+	std::vector<Row> ReadAll(SBcsvIO& bcsv) const
+	{
+		std::vector<Row> rows(bcsv.GetEntryCount());
+		ReadAllImpl(bcsv, rows, std::index_sequence_for<Fields...>{});
+		return rows;
+	}
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+constexpr uint32_t YAZ0_MAGIC = 0x59617A30; // 'Yaz0'
+constexpr uint32_t YAY0_MAGIC = 0x59617930; // 'Yay0'
+constexpr size_t YAZ0_HEADER_SIZE = 16;
+constexpr size_t YAY0_HEADER_SIZE = 16;
+
+enum class ECompressionFormat : uint8_t
+{
+	Yaz0,
+	Yay0
+};
+
+// How hard the compressor searches for matches. Fast is meant for quick saves while
+// editing, Max for the smallest output.
+enum class ECompressionLevel : uint8_t
+{
+	Fast,
+	Normal,
+	Max
+};
+
+// Yaz0/Yay0 codecs used in place of the byte-at-a-time ones in libgctools.
+namespace SCompression
+{
+	// Returns the decompressed size stored in a Yaz0 or Yay0 header, or 0 if the data
+	// isn't Yaz0/Yay0 compressed.
+	size_t GetDecompressedSize(const uint8_t* src, size_t src_size);
+
+	// Called with ranges of the compressed input the decoder is done with, so a caller decoding
+	// from a file mapping can drop those pages while the rest is decoded.
+	using SReleaseInputFn = std::function<void(size_t offset, size_t size)>;
+
+	// Decompress a Yaz0 or Yay0 stream into dst, which must hold the full decompressed size.
+	// Return false if the stream is malformed or doesn't fit in dst.
+	bool Yaz0Decompress(const uint8_t* src, size_t src_size, uint8_t* dst, size_t dst_size, const SReleaseInputFn& release_input = nullptr);
+	bool Yay0Decompress(const uint8_t* src, size_t src_size, uint8_t* dst, size_t dst_size, const SReleaseInputFn& release_input = nullptr);
+
+	// Compress src into dst, replacing its contents. Matches are searched for on several
+	// threads at once for large inputs; the output is the same whatever the thread count.
+	void Yaz0Compress(const uint8_t* src, size_t src_size, std::vector<uint8_t>& dst, ECompressionLevel level = ECompressionLevel::Normal);
+	void Yay0Compress(const uint8_t* src, size_t src_size, std::vector<uint8_t>& dst, ECompressionLevel level = ECompressionLevel::Normal);
+	void Compress(ECompressionFormat format, const uint8_t* src, size_t src_size, std::vector<uint8_t>& dst, ECompressionLevel level = ECompressionLevel::Normal);
+}
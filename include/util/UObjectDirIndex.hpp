@@ -0,0 +1,42 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+
+// Names of the object archives in a directory, so looking a model up doesn't touch the
+// filesystem. Built with one scan of the directory; on Linux, archives added or removed
+// afterwards are picked up through inotify on every lookup, once they've been written out in
+// full. Elsewhere Refresh scans the directory again.
+class UObjectDirIndex {
+	std::filesystem::path mDirectory;
+	// Archive names without their ".arc" extension.
+	std::unordered_set<std::string> mArchives;
+	// Names that were looked up and weren't there, so each is only reported once.
+	std::unordered_set<std::string> mMissing;
+
+	bool mNeedsScan { false };
+	int mNotifyFd { -1 };
+	int mWatch { -1 };
+
+	void Scan();
+	// Applies the inotify events queued since the last call. Does nothing without a watch.
+	void DrainEvents();
+	void CloseWatch();
+
+public:
+	UObjectDirIndex() = default;
+	UObjectDirIndex(const UObjectDirIndex&) = delete;
+	UObjectDirIndex& operator=(const UObjectDirIndex&) = delete;
+	~UObjectDirIndex() { CloseWatch(); }
+
+	// Takes effect on the next Refresh, which scans the new directory.
+	void SetDirectory(const std::filesystem::path& directory);
+	// Applies changes to the directory made since the last call.
+	void Refresh();
+
+	// Returns whether <directory>/<name>.arc exists. Prints a message the first time a name is missing.
+	bool Contains(std::string_view name);
+	std::filesystem::path GetArchivePath(std::string_view name) const { return mDirectory / (std::string(name) + ".arc"); }
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Maps each unique string to a small, stable integer ID so repeated names can be stored
+// and compared as integers. IDs stay valid until Clear is called.
+class UStringInterner {
+	// Storage for the interned strings, indexed by ID. A deque never moves its elements,
+	// so the views used as lookup keys stay valid as it grows.
+	std::deque<std::string> mStrings;
+	std::unordered_map<std::string_view, uint32_t> mIds;
+
+public:
+	// Returns the ID of the given string, assigning a new one if it hasn't been seen before.
+	uint32_t Intern(std::string_view str) {
+		auto it = mIds.find(str);
+		if (it != mIds.end())
+			return it->second;
+
+		uint32_t id = (uint32_t)mStrings.size();
+		mIds.insert({mStrings.emplace_back(str), id});
+
+		return id;
+	}
+
+	// Returns whether the given string has been interned, setting id to its ID if it has.
+	bool Find(std::string_view str, uint32_t& id) const {
+		auto it = mIds.find(str);
+		if (it == mIds.end())
+			return false;
+
+		id = it->second;
+		return true;
+	}
+
+	// Returns the string with the given ID.
+	const std::string& GetString(uint32_t id) const { return mStrings.at(id); }
+
+	size_t GetCount() const { return mStrings.size(); }
+
+	void Clear() {
+		mIds.clear();
+		mStrings.clear();
+	}
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// A fixed set of worker threads running submitted tasks in the order they were submitted.
+// Tasks shouldn't wait on other tasks in the same pool, every worker could end up waiting.
+class UThreadPool {
+	std::vector<std::thread> mWorkers;
+	std::deque<std::function<void()>> mTasks;
+	std::mutex mMutex;
+	std::condition_variable mCondition;
+	bool mStopping { false };
+
+	void WorkerLoop();
+
+public:
+	// Zero picks one worker per hardware thread.
+	explicit UThreadPool(size_t threadCount = 0);
+	UThreadPool(const UThreadPool&) = delete;
+	UThreadPool& operator=(const UThreadPool&) = delete;
+	// Finishes every queued task before returning.
+	~UThreadPool();
+
+	size_t GetThreadCount() const { return mWorkers.size(); }
+
+	template<typename F>
+	std::future<std::invoke_result_t<F>> Submit(F&& task) {
+		// std::function needs a copyable target, so the task is shared rather than moved in.
+		auto packaged = std::make_shared<std::packaged_task<std::invoke_result_t<F>()>>(std::forward<F>(task));
+		std::future<std::invoke_result_t<F>> result = packaged->get_future();
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mTasks.emplace_back([packaged]() { (*packaged)(); });
+		}
+
+		mCondition.notify_one();
+		return result;
+	}
+};
@@ -3,6 +3,93 @@
 
 #include <iconv.h>
 
+// The SIMD paths are built for every x86 target and picked at runtime, so they don't depend on
+// the compiler flags the build happens to use.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define CAMMIE_SWAP_SIMD
+#define CAMMIE_TARGET(isa) __attribute__((target(isa)))
+#include <immintrin.h>
+#elif defined(_MSC_VER) && defined(_M_X64)
+#define CAMMIE_SWAP_SIMD
+#define CAMMIE_TARGET(isa)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+#if defined(CAMMIE_SWAP_SIMD)
+// Each returns how many values it swapped, the rest are left to the scalar loop.
+CAMMIE_TARGET("ssse3") static size_t SwapEndianArray32SSSE3(uint32_t* data, size_t count) {
+    const __m128i swapMask128 = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i values = _mm_loadu_si128((const __m128i*)(data + i));
+        _mm_storeu_si128((__m128i*)(data + i), _mm_shuffle_epi8(values, swapMask128));
+    }
+
+    return i;
+}
+
+CAMMIE_TARGET("avx2") static size_t SwapEndianArray32AVX2(uint32_t* data, size_t count) {
+    const __m256i swapMask256 = _mm256_setr_epi8(
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12
+    );
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m256i values = _mm256_loadu_si256((const __m256i*)(data + i));
+        _mm256_storeu_si256((__m256i*)(data + i), _mm256_shuffle_epi8(values, swapMask256));
+    }
+
+    return i + SwapEndianArray32SSSE3(data + i, count - i);
+}
+
+static size_t (*SelectSwapEndianArray32())(uint32_t*, size_t) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+
+    __cpuid(info, 1);
+    bool ssse3 = (info[2] & (1 << 9)) != 0;
+    // AVX2 also needs the OS to save the YMM registers.
+    bool osYmm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+
+    bool avx2 = false;
+    if (maxLeaf >= 7 && osYmm) {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+    }
+#else
+    __builtin_cpu_init();
+    bool ssse3 = __builtin_cpu_supports("ssse3");
+    bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+
+    if (avx2)
+        return SwapEndianArray32AVX2;
+    if (ssse3)
+        return SwapEndianArray32SSSE3;
+    return nullptr;
+}
+#endif
+
+void LGenUtility::SwapEndianArray32(uint32_t* data, size_t count) {
+    size_t i = 0;
+
+#if defined(CAMMIE_SWAP_SIMD)
+    static size_t (*const simdSwap)(uint32_t*, size_t) = SelectSwapEndianArray32();
+    if (simdSwap != nullptr)
+        i = simdSwap(data, count);
+#endif
+
+    for (; i < count; i++) {
+        uint32_t value = data[i];
+        data[i] = (value >> 24) | ((value >> 8) & 0xFF00) | ((value << 8) & 0xFF0000) | (value << 24);
+    }
+}
+
 std::string LGenUtility::Utf8ToSjis(const std::string& value) {
     iconv_t conv = iconv_open("SHIFT-JIS", "UTF-8");
     if (conv == (iconv_t)(-1)) {
@@ -1,93 +1,1035 @@
 #include "ResUtil.hpp"
+#include "io/BcsvIO.hpp"
+#include "io/Compression.hpp"
 #include "ini.h"
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
+#include <thread>
 #include <imgui.h>
 #include <ImGuiFileDialog.h>
 #include <fmt/core.h>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define CAMMIE_HAS_MMAP
+#endif
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#endif
+
 SResUtility::SGCResourceManager GCResourceManager;
 SResUtility::SOptions Options;
 
 void SResUtility::SGCResourceManager::Init()
 {
+	GetContext();
+	mInitialized = true;
+}
+
+GCcontext* SResUtility::SGCResourceManager::GetContext()
+{
+	// There's only ever the one manager, so a single slot per thread is enough.
+	thread_local GCcontext* context = nullptr;
+	if (context != nullptr)
+		return context;
+
+	std::lock_guard<std::mutex> lock(mContextMutex);
+	context = &mContexts.emplace_back();
+
 	GCerror err;
-	if ((err = gcInitContext(&mResManagerContext)) != GC_ERROR_SUCCESS)
+	if ((err = gcInitContext(context)) != GC_ERROR_SUCCESS)
 	{
 		printf("Error initing arc loader context: %s\n", gcGetErrorMessage(err));
 	}
 
-	mInitialized = true;
+	return context;
 }
 
-bool SResUtility::SGCResourceManager::LoadArchive(const char* path, GCarchive* archive)
+bool SResUtility::SMappedFile::Open(const char* path)
 {
-	if(!mInitialized) return false;
-	
-	GCerror err;
+	Close();
 
-	FILE* f = fopen(path, "rb");
-	if (f == nullptr)
+#ifdef CAMMIE_HAS_MMAP
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
 	{
-		printf("Error opening file \"%s\"\n", path);
+		close(fd);
 		return false;
 	}
 
+	void* mapping = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (mapping == MAP_FAILED)
+		return false;
+
+	// Archives are read front to back, let the kernel read ahead aggressively.
+	madvise(mapping, (size_t)fileStat.st_size, MADV_SEQUENTIAL);
+
+	mData = (uint8_t*)mapping;
+	mSize = (size_t)fileStat.st_size;
+	mMapped = true;
+
+	return true;
+#else
+	FILE* f = fopen(path, "rb");
+	if (f == nullptr)
+		return false;
+
 	fseek(f, 0L, SEEK_END);
-	GCsize size = (GCsize)ftell(f);
+	size_t size = (size_t)ftell(f);
 	rewind(f);
 
-	void* file = malloc(size);
-	if (file == nullptr)
+	mData = (uint8_t*)malloc(size);
+	if (mData == nullptr)
 	{
-		printf("Error allocating buffer for file \"%s\"\n", path);
+		fclose(f);
 		return false;
 	}
 
-	fread(file, 1, size, f);
+	mSize = fread(mData, 1, size, f);
 	fclose(f);
 
-	// If the file starts with 'Yay0', it's Yay0 compressed.
-	if (*((uint32_t*)file) == 0x30796159)
-	{
-		GCsize compressedSize = gcDecompressedSize(&mResManagerContext, (GCuint8*)file, 0);
+	return mSize == size;
+#endif
+}
+
+void SResUtility::SMappedFile::Release(size_t offset, size_t size)
+{
+#ifdef CAMMIE_HAS_MMAP
+	if (!mMapped || offset >= mSize)
+		return;
 
-		void* decompBuffer = malloc(compressedSize);
-		gcYay0Decompress(&mResManagerContext, (GCuint8*)file, (GCuint8*)decompBuffer, compressedSize, 0);
+	// Only whole pages inside the range can go.
+	size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+	size_t start = (offset + pageSize - 1) & ~(pageSize - 1);
+	size_t end = std::min(offset + size, mSize) & ~(pageSize - 1);
 
-		free(file);
-		size = compressedSize;
-		file = decompBuffer;
+	if (end > start)
+		madvise(mData + start, end - start, MADV_DONTNEED);
+#endif
+}
+
+void SResUtility::SMappedFile::Close()
+{
+	if (mData == nullptr)
+		return;
+
+#ifdef CAMMIE_HAS_MMAP
+	if (mMapped)
+		munmap(mData, mSize);
+	else
+		free(mData);
+#else
+	free(mData);
+#endif
+
+	mData = nullptr;
+	mSize = 0;
+	mMapped = false;
+}
+
+SResUtility::SArchiveData::~SArchiveData()
+{
+	free(Buffer);
+}
+
+bool SResUtility::SGCResourceManager::ReadArchiveData(const char* path, SArchiveData& out)
+{
+	// The raw file is never copied; uncompressed archives are used straight from the mapping.
+	SMappedFile& mapping = out.Mapping;
+	if (!mapping.Open(path) || mapping.GetSize() < sizeof(uint32_t))
+	{
+		printf("Error opening file \"%s\"\n", path);
+		return false;
 	}
-	// Likewise, if the file starts with 'Yaz0' it's Yaz0 compressed.
-	else if (*((uint32_t*)file) == 0x307A6159)
+
+	out.Data = mapping.GetData();
+	out.Size = mapping.GetSize();
+
+	uint32_t magic;
+	memcpy(&magic, out.Data, sizeof(uint32_t));
+
+	// If the file starts with 'Yay0' or 'Yaz0', it's compressed.
+	if (magic == 0x30796159 || magic == 0x307A6159)
 	{
-		GCsize compressedSize = gcDecompressedSize(&mResManagerContext, (GCuint8*)file, 0);
+		bool isYay0 = magic == 0x30796159;
+		size_t decompressedSize = SCompression::GetDecompressedSize(out.Data, out.Size);
+		if (decompressedSize == 0)
+		{
+			printf("Error reading compressed file \"%s\"\n", path);
+			return false;
+		}
+
+		std::filesystem::path cachePath = GetCachePath(path, mapping.GetSize());
+		if (!cachePath.empty() && out.CacheMapping.Open(cachePath.string().c_str()) && out.CacheMapping.GetSize() == decompressedSize)
+		{
+			// Bump the entry so it's the last to be evicted.
+			std::error_code ec;
+			std::filesystem::last_write_time(cachePath, std::filesystem::file_time_type::clock::now(), ec);
+
+			out.Data = out.CacheMapping.GetData();
+			out.Size = decompressedSize;
+		}
+		else
+		{
+			out.CacheMapping.Close();
+
+			out.Buffer = malloc(decompressedSize);
+			if (out.Buffer == nullptr)
+			{
+				printf("Error allocating buffer for file \"%s\"\n", path);
+				return false;
+			}
+
+			// Only the part of the mapping being decoded stays resident, not the whole compressed file.
+			if (!DecompressFile(mapping, (GCuint8*)out.Buffer, decompressedSize, isYay0))
+			{
+				printf("Error decompressing file \"%s\"\n", path);
+				return false;
+			}
+
+			out.Data = (const uint8_t*)out.Buffer;
+			out.Size = decompressedSize;
+
+			if (!cachePath.empty())
+				WriteCacheEntry(cachePath, out.Data, out.Size);
+		}
 
-		void* decompBuffer = malloc(compressedSize);
-		gcYaz0Decompress(&mResManagerContext, (GCuint8*)file, (GCuint8*)decompBuffer, compressedSize, 0);
-		free(file);
-		size = compressedSize;
-		file = decompBuffer;
+		// The compressed data isn't needed past this point.
+		mapping.Close();
 	}
 
-	gcInitArchive(archive, &mResManagerContext);
-	if ((err = gcLoadArchive(archive, file, size)) != GC_ERROR_SUCCESS) {
+	return true;
+}
+
+bool SResUtility::SGCResourceManager::LoadArchive(const char* path, SArchive* archive)
+{
+	if(!mInitialized) return false;
+
+	archive->Close();
+
+	GCerror err;
+
+	// gcLoadArchive copies the files out of whichever buffer we give it, so the data
+	// is released as soon as the archive is loaded.
+	SArchiveData data;
+	if (!ReadArchiveData(path, data))
+		return false;
+
+	gcInitArchive(&archive->mArchive, GetContext());
+	err = gcLoadArchive(&archive->mArchive, (GCuint8*)data.Data, (GCsize)data.Size);
+
+	if (err != GC_ERROR_SUCCESS) {
 		printf("Error Loading Archive: %s\n", gcGetErrorMessage(err));
 		return false;
 	}
 
+	if (mDeduplicateFiles)
+		DeduplicateFiles(&archive->mArchive);
+
+	archive->mIndex.Build(&archive->mArchive);
+	archive->mManager = this;
+
+	std::lock_guard<std::mutex> lock(mArchiveMutex);
+	mArchives.insert(archive);
+
 	return true;
 }
 
-bool SResUtility::SGCResourceManager::ReplaceArchiveFileData(GCarcfile* file, uint8_t* new_data, size_t new_data_size){
+std::shared_ptr<SResUtility::SArchive> SResUtility::SGCResourceManager::AcquireArchive(const char* path)
+{
+	if(!mInitialized) return nullptr;
+
+	std::error_code ec;
+	std::string key = std::filesystem::absolute(path, ec).lexically_normal().string();
+	auto writeTime = std::filesystem::last_write_time(path, ec);
+	uintmax_t fileSize = std::filesystem::file_size(path, ec);
+	if (ec)
+		return nullptr;
+
+	{
+		std::lock_guard<std::mutex> lock(mArchiveCacheMutex);
+
+		auto cached = mArchiveCache.find(key);
+		if (cached != mArchiveCache.end())
+		{
+			SArchiveCacheEntry& entry = cached->second;
+			if (entry.WriteTime == writeTime && entry.FileSize == fileSize)
+			{
+				mArchiveCacheHits++;
+				mArchiveLru.splice(mArchiveLru.begin(), mArchiveLru, entry.LruPos);
+				return entry.Archive;
+			}
+
+			// Changed on disk, anyone still holding the old copy keeps it until they let go.
+			mArchiveCacheBytes -= entry.Bytes;
+			mArchiveLru.erase(entry.LruPos);
+			mArchiveCache.erase(cached);
+		}
+
+		mArchiveCacheMisses++;
+	}
+
+	// Loaded without the lock held so other threads aren't stuck behind a slow archive.
+	std::shared_ptr<SArchive> archive = std::make_shared<SArchive>();
+	if (!LoadArchive(path, archive.get()))
+		return nullptr;
+
+	size_t bytes = 0;
+	const GCarchive& loaded = archive->mArchive;
+	for (GCarcfile* file = loaded.files; file < loaded.files + loaded.filenum; file++)
+	{
+		if (!(file->attr & 0x02))
+			bytes += file->size;
+	}
+
+	std::lock_guard<std::mutex> lock(mArchiveCacheMutex);
+
+	// Another thread may have loaded the same archive in the meantime, share theirs.
+	auto cached = mArchiveCache.find(key);
+	if (cached != mArchiveCache.end() && cached->second.WriteTime == writeTime && cached->second.FileSize == fileSize)
+	{
+		mArchiveLru.splice(mArchiveLru.begin(), mArchiveLru, cached->second.LruPos);
+		return cached->second.Archive;
+	}
+
+	if (cached != mArchiveCache.end())
+	{
+		mArchiveCacheBytes -= cached->second.Bytes;
+		mArchiveLru.erase(cached->second.LruPos);
+		mArchiveCache.erase(cached);
+	}
+
+	mArchiveLru.push_front(key);
+	mArchiveCache[key] = { archive, bytes, writeTime, fileSize, mArchiveLru.begin() };
+	mArchiveCacheBytes += bytes;
+
+	EvictArchives();
+
+	return archive;
+}
+
+void SResUtility::SGCResourceManager::EvictArchives()
+{
+	while (mArchiveCacheBytes > mArchiveCacheBudget && !mArchiveLru.empty())
+	{
+		auto entry = mArchiveCache.find(mArchiveLru.back());
+		mArchiveCacheBytes -= entry->second.Bytes;
+		mArchiveCache.erase(entry);
+		mArchiveLru.pop_back();
+	}
+}
+
+void SResUtility::SGCResourceManager::SetArchiveCacheBudget(size_t budget)
+{
+	std::lock_guard<std::mutex> lock(mArchiveCacheMutex);
+	mArchiveCacheBudget = budget;
+	EvictArchives();
+}
+
+void SResUtility::SGCResourceManager::ClearArchiveCache()
+{
+	std::lock_guard<std::mutex> lock(mArchiveCacheMutex);
+	mArchiveCache.clear();
+	mArchiveLru.clear();
+	mArchiveCacheBytes = 0;
+}
+
+void SResUtility::SGCResourceManager::RenderArchiveCacheStats()
+{
+	std::lock_guard<std::mutex> lock(mArchiveCacheMutex);
+	ImGui::Text(fmt::format("Archives: {0} cached, {1:.1f} MB resident", mArchiveCache.size(), mArchiveCacheBytes / (1024.0f * 1024.0f)).data());
+	ImGui::Text(fmt::format("Hits: {0} Misses: {1}", mArchiveCacheHits, mArchiveCacheMisses).data());
+
+	std::lock_guard<std::mutex> sharedLock(mSharedBufferMutex);
+	ImGui::Text(fmt::format("Shared files: {0:.1f} MB saved", mDedupBytesSaved / (1024.0f * 1024.0f)).data());
+}
+
+bool SResUtility::SGCResourceManager::LoadArchiveLazy(const char* path, SLazyArchive* archive)
+{
 	if(!mInitialized) return false;
+
+	archive->Close();
+
+	if (!ReadArchiveData(path, archive->mData))
+		return false;
+
+	if (!archive->Parse(GetContext()))
+	{
+		printf("Error Loading Archive: \"%s\" isn't a valid RARC archive\n", path);
+		archive->Close();
+		return false;
+	}
+
+	return true;
+}
+
+void SResUtility::SArchive::Close()
+{
+	if (mManager != nullptr)
+		mManager->FreeArchive(this);
+}
+
+std::span<const GCarcfile* const> SResUtility::SArchive::GetChildren(std::string_view path) const
+{
+	std::span<GCarcfile* const> children = mIndex.GetChildren(path);
+	return std::span<const GCarcfile* const>(children.data(), children.size());
+}
+
+GCarcfile* SResUtility::SArchive::GetFile(const GCarcfile* file)
+{
+	if (file < mArchive.files || file >= mArchive.files + mArchive.filenum)
+		return nullptr;
+
+	return mArchive.files + (file - mArchive.files);
+}
+
+uint8_t* SResUtility::SArchive::GetWritableData(const GCarcfile* file)
+{
+	GCarcfile* ownFile = GetFile(file);
+	if (mManager == nullptr || ownFile == nullptr || !mManager->MakeFileDataPrivate(this, ownFile))
+		return nullptr;
+
+	return (uint8_t*)ownFile->data;
+}
+
+void SResUtility::SGCResourceManager::FreeArchive(SArchive* archive)
+{
+	{
+		std::lock_guard<std::mutex> lock(mArchiveMutex);
+		mArchives.erase(archive);
+	}
+
+	archive->mIndex.Clear();
+
+	// Shared data is cleared out of the archive so gcFreeArchive leaves it to the other users.
+	GCarchive* loaded = &archive->mArchive;
+	for (GCarcfile* file = loaded->files; file < loaded->files + loaded->filenum; file++)
+	{
+		if (!(file->attr & 0x02) && file->data != nullptr)
+			ReleaseSharedData(file);
+	}
+
+	gcFreeArchive(loaded);
+	archive->mArchive = {};
+	archive->mManager = nullptr;
+}
+
+namespace {
+	// Only worth sharing files big enough to outweigh the bookkeeping.
+	constexpr size_t MIN_SHARED_FILE_SIZE = 256;
+
+	uint64_t HashFileData(const uint8_t* data, size_t size)
+	{
+		uint64_t hash = 0x9E3779B97F4A7C15 ^ size;
+
+		size_t i = 0;
+		for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+		{
+			uint64_t word;
+			memcpy(&word, data + i, sizeof(uint64_t));
+			hash = (hash ^ word) * 0xFF51AFD7ED558CCD;
+			hash ^= hash >> 32;
+		}
+
+		for (; i < size; i++)
+			hash = (hash ^ data[i]) * 0x100000001B3;
+
+		hash ^= hash >> 33;
+		hash *= 0xC4CEB9FE1A85EC53;
+		hash ^= hash >> 33;
+
+		return hash;
+	}
+}
+
+void SResUtility::SGCResourceManager::DeduplicateFiles(GCarchive* archive)
+{
+	std::vector<std::pair<GCarcfile*, uint64_t>> files;
+	for (GCarcfile* file = archive->files; file < archive->files + archive->filenum; file++)
+	{
+		if (!(file->attr & 0x02) && file->data != nullptr && file->size >= MIN_SHARED_FILE_SIZE)
+			files.push_back({ file, HashFileData((const uint8_t*)file->data, file->size) });
+	}
+
+	std::lock_guard<std::mutex> lock(mSharedBufferMutex);
+
+	for (auto& [file, hash] : files)
+	{
+		void* match = nullptr;
+
+		// Equal hashes are compared byte for byte, a collision must never swap file contents.
+		auto candidates = mSharedBuffersByHash.equal_range(hash);
+		for (auto candidate = candidates.first; candidate != candidates.second; candidate++)
+		{
+			if (mSharedBuffers[candidate->second].Size == file->size && memcmp(candidate->second, file->data, file->size) == 0)
+			{
+				match = candidate->second;
+				break;
+			}
+		}
+
+		if (match == nullptr)
+		{
+			mSharedBuffers[file->data] = { hash, file->size, 1, archive->ctx };
+			mSharedBuffersByHash.insert({ hash, file->data });
+			continue;
+		}
+
+		gcFreeMem(archive->ctx, file->data);
+		file->data = match;
+		mSharedBuffers[match].RefCount++;
+		mDedupBytesSaved += file->size;
+	}
+}
+
+void SResUtility::SGCResourceManager::ForgetSharedBuffer(std::unordered_map<void*, SSharedBuffer>::iterator shared)
+{
+	auto candidates = mSharedBuffersByHash.equal_range(shared->second.Hash);
+	for (auto candidate = candidates.first; candidate != candidates.second; candidate++)
+	{
+		if (candidate->second == shared->first)
+		{
+			mSharedBuffersByHash.erase(candidate);
+			break;
+		}
+	}
+
+	mSharedBuffers.erase(shared);
+}
+
+bool SResUtility::SGCResourceManager::ReleaseSharedData(GCarcfile* file)
+{
+	std::lock_guard<std::mutex> lock(mSharedBufferMutex);
+
+	auto shared = mSharedBuffers.find(file->data);
+	if (shared == mSharedBuffers.end())
+		return false;
+
+	if (--shared->second.RefCount == 0)
+	{
+		GCcontext* context = shared->second.Context;
+		ForgetSharedBuffer(shared);
+		gcFreeMem(context, file->data);
+	}
+	else
+	{
+		mDedupBytesSaved -= shared->second.Size;
+	}
+
+	file->data = nullptr;
+	return true;
+}
+
+bool SResUtility::SGCResourceManager::MakeFileDataPrivate(SArchive* archive, GCarcfile* file)
+{
+	std::lock_guard<std::mutex> lock(mSharedBufferMutex);
+
+	auto shared = mSharedBuffers.find(file->data);
+	if (shared == mSharedBuffers.end())
+		return true;
+
+	GCcontext* context = archive->mArchive.ctx;
+
+	// The only user can keep the buffer, it just can't be handed out to anyone else. Unless
+	// it came from another archive's context, the archive's own one couldn't free it later.
+	if (shared->second.RefCount == 1 && shared->second.Context == context)
+	{
+		ForgetSharedBuffer(shared);
+		return true;
+	}
+
+	void* copy = gcAllocMem(context, file->size);
+	if (copy == nullptr)
+		return false;
+
+	memcpy(copy, file->data, file->size);
+
+	if (--shared->second.RefCount == 0)
+	{
+		GCcontext* sharedContext = shared->second.Context;
+		ForgetSharedBuffer(shared);
+		gcFreeMem(sharedContext, file->data);
+	}
+	else
+	{
+		mDedupBytesSaved -= shared->second.Size;
+	}
+
+	file->data = copy;
+	return true;
+}
+
+size_t SResUtility::SArchiveIndex::SPathHash::operator()(std::string_view path) const
+{
+	size_t hash = 0xCBF29CE484222325;
+	for (char c : path)
+	{
+		hash ^= (uint8_t)tolower((uint8_t)c);
+		hash *= 0x100000001B3;
+	}
+
+	return hash;
+}
+
+bool SResUtility::SArchiveIndex::SPathEqual::operator()(std::string_view a, std::string_view b) const
+{
+	if (a.size() != b.size())
+		return false;
+
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		if (tolower((uint8_t)a[i]) != tolower((uint8_t)b[i]))
+			return false;
+	}
+
+	return true;
+}
+
+void SResUtility::SArchiveIndex::Build(GCarchive* archive)
+{
+	Clear();
+
+	if (archive->dirnum == 0)
+		return;
+
+	mFiles.reserve(archive->filenum);
+	mChildren.reserve(archive->filenum);
+
+	AddDirectory(archive, 0, "", 0);
+}
+
+void SResUtility::SArchiveIndex::AddDirectory(GCarchive* archive, uint32_t dirIndex, const std::string& path, uint32_t depth)
+{
+	// Deeper than any real archive goes, so a malformed one can't recurse forever.
+	if (dirIndex >= archive->dirnum || depth > 64 || mDirs.contains(path))
+		return;
+
+	GCarcdir* dir = &archive->dirs[dirIndex];
+	if ((size_t)dir->fileoff + dir->filenum > archive->filenum)
+		return;
+
+	SDirRange& range = mDirs[path];
+	range.Start = (uint32_t)mChildren.size();
+
+	std::vector<GCarcfile*> subdirs;
+	for (GCarcfile* file = &archive->files[dir->fileoff]; file < &archive->files[dir->fileoff] + dir->filenum; file++)
+	{
+		if (strcmp(file->name, ".") == 0 || strcmp(file->name, "..") == 0)
+			continue;
+
+		mChildren.push_back(file);
+		mFiles.insert({ path.empty() ? std::string(file->name) : path + "/" + file->name, file });
+
+		if (file->attr & 0x02)
+			subdirs.push_back(file);
+	}
+
+	range.Count = (uint32_t)mChildren.size() - range.Start;
+
+	// Children are added after the loop so this directory's range stays contiguous.
+	for (GCarcfile* subdir : subdirs)
+		AddDirectory(archive, subdir->size, path.empty() ? std::string(subdir->name) : path + "/" + subdir->name, depth + 1);
+}
+
+void SResUtility::SArchiveIndex::Clear()
+{
+	mFiles.clear();
+	mDirs.clear();
+	mChildren.clear();
+}
+
+GCarcfile* SResUtility::SArchiveIndex::Find(std::string_view path) const
+{
+	auto file = mFiles.find(path);
+	return file != mFiles.end() ? file->second : nullptr;
+}
+
+std::span<GCarcfile* const> SResUtility::SArchiveIndex::GetChildren(std::string_view path) const
+{
+	auto dir = mDirs.find(path);
+	if (dir == mDirs.end())
+		return {};
+
+	return std::span<GCarcfile* const>(mChildren.data() + dir->second.Start, dir->second.Count);
+}
+
+void SResUtility::SGCResourceManager::SetCacheDirectory(const std::filesystem::path& dir, size_t budget)
+{
+	std::lock_guard<std::mutex> lock(mDiskCacheMutex);
+
+	mCacheDir = dir;
+	mCacheBudget = budget;
+
+	if (mCacheDir.empty())
+		return;
+
+	std::error_code ec;
+	std::filesystem::create_directories(mCacheDir, ec);
+	if (ec)
+	{
+		printf("Error creating archive cache directory \"%s\", caching disabled\n", mCacheDir.string().c_str());
+		mCacheDir.clear();
+		return;
+	}
+
+	TrimCache();
+}
+
+std::filesystem::path SResUtility::SGCResourceManager::GetCachePath(const char* path, size_t size)
+{
+	std::filesystem::path cacheDir;
+	{
+		std::lock_guard<std::mutex> lock(mDiskCacheMutex);
+		cacheDir = mCacheDir;
+	}
+
+	if (cacheDir.empty())
+		return {};
+
+	std::error_code ec;
+	std::filesystem::path absolutePath = std::filesystem::absolute(path, ec);
+	if (ec)
+		return {};
+
+	auto mtime = std::filesystem::last_write_time(absolutePath, ec);
+	if (ec)
+		return {};
+
+	// Any edit to the source archive changes its size or mtime, which gives it a new entry.
+	// The stale one is left for TrimCache to evict.
+	std::string key = fmt::format("{0}|{1}|{2}", absolutePath.string(), size, (int64_t)mtime.time_since_epoch().count());
+
+	uint64_t hash = 0xCBF29CE484222325;
+	for (char c : key)
+	{
+		hash ^= (uint8_t)c;
+		hash *= 0x100000001B3;
+	}
+
+	return cacheDir / fmt::format("{0:016x}.arc", hash);
+}
+
+void SResUtility::SGCResourceManager::WriteCacheEntry(const std::filesystem::path& cachePath, const uint8_t* data, size_t size)
+{
+	// Written under a temporary name so a crash never leaves a truncated entry behind.
+	// The name is per thread in case two threads are writing out the same archive.
+	std::filesystem::path tempPath = cachePath;
+	tempPath += fmt::format(".{0}.tmp", std::hash<std::thread::id>()(std::this_thread::get_id()));
+
+	std::ofstream cacheFile(tempPath, std::ios::binary | std::ios::out);
+	if (!cacheFile.is_open())
+		return;
+
+	cacheFile.write((const char*)data, size);
+	cacheFile.close();
+
+	std::error_code ec;
+	if (cacheFile.fail())
+	{
+		std::filesystem::remove(tempPath, ec);
+		return;
+	}
+
+	std::filesystem::rename(tempPath, cachePath, ec);
+	if (ec)
+	{
+		std::filesystem::remove(tempPath, ec);
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(mDiskCacheMutex);
+	TrimCache();
+}
+
+void SResUtility::SGCResourceManager::TrimCache()
+{
+	if (mCacheDir.empty())
+		return;
+
+	struct SCacheEntry
+	{
+		std::filesystem::path Path;
+		std::filesystem::file_time_type LastUsed;
+		uintmax_t Size;
+	};
+
+	std::vector<SCacheEntry> entries;
+	uintmax_t totalSize = 0;
+
+	// Temporary files older than this were left behind by a crash in WriteCacheEntry rather
+	// than being written right now.
+	constexpr auto staleTempAge = std::chrono::minutes(10);
+	auto now = std::filesystem::file_time_type::clock::now();
+
+	std::error_code ec;
+	for (const auto& dirEntry : std::filesystem::directory_iterator(mCacheDir, ec))
+	{
+		if (!dirEntry.is_regular_file(ec))
+			continue;
+
+		if (dirEntry.path().extension() == ".tmp")
+		{
+			// Ones still being written count against the budget, but can't be evicted.
+			if (now - dirEntry.last_write_time(ec) > staleTempAge)
+			{
+				std::filesystem::remove(dirEntry.path(), ec);
+			}
+			else
+			{
+				uintmax_t tempSize = dirEntry.file_size(ec);
+				if (!ec)
+					totalSize += tempSize;
+			}
+
+			continue;
+		}
+
+		if (dirEntry.path().extension() != ".arc")
+			continue;
+
+		SCacheEntry entry { dirEntry.path(), dirEntry.last_write_time(ec), dirEntry.file_size(ec) };
+		totalSize += entry.Size;
+		entries.push_back(entry);
+	}
+
+	if (totalSize <= mCacheBudget)
+		return;
+
+	// Hits bump an entry's mtime, so the oldest mtime is the least recently used.
+	std::sort(entries.begin(), entries.end(), [](const SCacheEntry& a, const SCacheEntry& b) { return a.LastUsed < b.LastUsed; });
+
+	for (const SCacheEntry& entry : entries)
+	{
+		if (totalSize <= mCacheBudget)
+			break;
+
+		// Removing a file that's still mapped is fine, the mapping stays valid until it's closed.
+		if (std::filesystem::remove(entry.Path, ec))
+			totalSize -= entry.Size;
+	}
+}
+
+namespace {
+	uint32_t ReadU32BE(const uint8_t* src)
+	{
+		return src[0] << 24 | src[1] << 16 | src[2] << 8 | src[3];
+	}
+
+	uint16_t ReadU16BE(const uint8_t* src)
+	{
+		return src[0] << 8 | src[1];
+	}
+
+	constexpr size_t RARC_HEADER_SIZE = 0x20;
+	constexpr size_t RARC_INFO_SIZE = 0x20;
+	constexpr size_t RARC_NODE_SIZE = 0x10;
+	constexpr size_t RARC_ENTRY_SIZE = 0x14;
+}
+
+bool SResUtility::SLazyArchive::Parse(GCcontext* context)
+{
+	mContext = context;
+
+	const uint8_t* data = mData.Data;
+	size_t size = mData.Size;
+
+	if (size < RARC_HEADER_SIZE + RARC_INFO_SIZE || memcmp(data, "RARC", 4) != 0)
+		return false;
+
+	// Every offset past the header is relative to the end of it.
+	const uint8_t* info = data + RARC_HEADER_SIZE;
+	mFileDataOffset = RARC_HEADER_SIZE + ReadU32BE(data + 0x0C);
+
+	uint32_t nodeCount = ReadU32BE(info + 0x00);
+	size_t nodeOffset = RARC_HEADER_SIZE + ReadU32BE(info + 0x04);
+	uint32_t entryCount = ReadU32BE(info + 0x08);
+	size_t entryOffset = RARC_HEADER_SIZE + ReadU32BE(info + 0x0C);
+	mStringTableSize = ReadU32BE(info + 0x10);
+	size_t stringTableOffset = RARC_HEADER_SIZE + ReadU32BE(info + 0x14);
+
+	if (nodeOffset + (size_t)nodeCount * RARC_NODE_SIZE > size || entryOffset + (size_t)entryCount * RARC_ENTRY_SIZE > size ||
+	    stringTableOffset + mStringTableSize > size || mFileDataOffset > size || nodeCount == 0)
+		return false;
+
+	mStringTable = (const char*)data + stringTableOffset;
+
+	mDirs.resize(nodeCount);
+	mFiles.resize(entryCount);
+	mFileOffsets.resize(entryCount);
+	mMaterialized.assign(entryCount, false);
+
+	for (uint32_t i = 0; i < nodeCount; i++)
+	{
+		const uint8_t* node = data + nodeOffset + i * RARC_NODE_SIZE;
+		GCarcdir& dir = mDirs[i];
+
+		dir.name = GetString(ReadU32BE(node + 0x04));
+		dir.filenum = ReadU16BE(node + 0x0A);
+		dir.fileoff = ReadU32BE(node + 0x0C);
+
+		if ((size_t)dir.fileoff + dir.filenum > entryCount)
+			return false;
+	}
+
+	for (uint32_t i = 0; i < entryCount; i++)
+	{
+		const uint8_t* entry = data + entryOffset + i * RARC_ENTRY_SIZE;
+		GCarcfile& file = mFiles[i];
+
+		uint32_t typeAndName = ReadU32BE(entry + 0x04);
+
+		file.id = ReadU16BE(entry + 0x00);
+		file.attr = typeAndName >> 24;
+		file.name = GetString(typeAndName & 0x00FFFFFF);
+		file.data = nullptr;
+
+		// Directories store the index of their node where files store their data offset,
+		// which matches how gcLoadArchive fills in size for directories.
+		if (file.attr & 0x02)
+		{
+			file.size = ReadU32BE(entry + 0x08);
+		}
+		else
+		{
+			mFileOffsets[i] = ReadU32BE(entry + 0x08);
+			file.size = ReadU32BE(entry + 0x0C);
+		}
+	}
+
+	for (GCarcdir& dir : mDirs)
+	{
+		for (uint32_t i = dir.fileoff; i < dir.fileoff + dir.filenum; i++)
+			mFiles[i].parent = &dir;
+	}
+
+	GCarchive view {};
+	view.ctx = context;
+	view.dirnum = nodeCount;
+	view.filenum = entryCount;
+	view.dirs = mDirs.data();
+	view.files = mFiles.data();
+	mIndex.Build(&view);
+
+	return true;
+}
+
+char* SResUtility::SLazyArchive::GetString(uint32_t offset) const
+{
+	static char empty[] = "";
+
+	if (offset >= mStringTableSize || memchr(mStringTable + offset, 0, mStringTableSize - offset) == nullptr)
+		return empty;
+
+	return (char*)mStringTable + offset;
+}
+
+bool SResUtility::SLazyArchive::Materialize(GCarcfile* file)
+{
+	if (file < mFiles.data() || file >= mFiles.data() + mFiles.size())
+		return false;
+
+	size_t index = file - mFiles.data();
+
+	std::lock_guard<std::mutex> lock(mMaterializeMutex);
+	if (mMaterialized[index] || (file->attr & 0x02))
+		return true;
+
+	size_t offset = mFileDataOffset + mFileOffsets[index];
+	if (offset > mData.Size || file->size > mData.Size - offset)
+		return false;
+
+	// Copied into memory owned by the context, like gcLoadArchive does, so the file can be
+	// edited and replaced the same way as one from an eagerly loaded archive.
+	file->data = gcAllocMem(mContext, file->size);
+	if (file->data == nullptr)
+		return false;
+
+	memcpy(file->data, mData.Data + offset, file->size);
+	mMaterialized[index] = true;
+
+	return true;
+}
+
+GCarcfile* SResUtility::SLazyArchive::Find(std::string_view path)
+{
+	GCarcfile* file = mIndex.Find(path);
+	if (file == nullptr || !Materialize(file))
+		return nullptr;
+
+	return file;
+}
+
+void SResUtility::SLazyArchive::Close()
+{
+	for (size_t i = 0; i < mFiles.size(); i++)
+	{
+		if (mMaterialized[i])
+			gcFreeMem(mContext, mFiles[i].data);
+	}
+
+	mIndex.Clear();
+	mDirs.clear();
+	mFiles.clear();
+	mFileOffsets.clear();
+	mMaterialized.clear();
+	mStringTable = nullptr;
+	mStringTableSize = 0;
+
+	mData.Mapping.Close();
+	mData.CacheMapping.Close();
+	free(mData.Buffer);
+	mData.Buffer = nullptr;
+	mData.Data = nullptr;
+	mData.Size = 0;
+}
+
+bool SResUtility::SGCResourceManager::DecompressFile(SMappedFile& mapping, uint8_t* dst, size_t dst_size, bool yay0)
+{
+	// A stream the in-tree decoder rejects is malformed, so it's never handed on to libgctools,
+	// which doesn't bounds check its input.
+	if (mUseFastDecompressor)
+	{
+		auto release = [&mapping](size_t offset, size_t size) { mapping.Release(offset, size); };
+
+		return yay0 ? SCompression::Yay0Decompress(mapping.GetData(), mapping.GetSize(), dst, dst_size, release)
+		            : SCompression::Yaz0Decompress(mapping.GetData(), mapping.GetSize(), dst, dst_size, release);
+	}
+
+	GCerror err = yay0 ? gcYay0Decompress(GetContext(), (GCuint8*)mapping.GetData(), dst, dst_size, 0)
+	                   : gcYaz0Decompress(GetContext(), (GCuint8*)mapping.GetData(), dst, dst_size, 0);
+
+	return err == GC_ERROR_SUCCESS;
+}
+
+bool SResUtility::SGCResourceManager::ReplaceArchiveFileData(SArchive* archive, const GCarcfile* archiveFile, uint8_t* new_data, size_t new_data_size){
+	if(!mInitialized || !archive->IsLoaded()) return false;
+
+	GCarcfile* file = archive->GetFile(archiveFile);
+	if(file == nullptr) return false;
+
+	// The archive may have been loaded on another thread, its memory belongs to that context.
+	GCcontext* context = archive->mArchive.ctx;
 	
-	// free existing file
-	gcFreeMem(&mResManagerContext, file->data);
+	// free existing file, unless other archives are still using it
+	if (!ReleaseSharedData(file))
+		gcFreeMem(context, file->data);
 
 	//allocate size of new file
-	file->data = gcAllocMem(&mResManagerContext, new_data_size);
+	file->data = gcAllocMem(context, new_data_size);
 		
 	//copy new jmp to file buffer for arc
 	memcpy(file->data, new_data, new_data_size);
@@ -98,29 +1040,232 @@ bool SResUtility::SGCResourceManager::ReplaceArchiveFileData(GCarcfile* file, ui
 	return true;
 }
 
-bool SResUtility::SGCResourceManager::SaveArchiveCompressed(const char* path, GCarchive* archive)
-{
+bool SResUtility::SGCResourceManager::CommitBcsv(SArchive* archive, const GCarcfile* file, SBcsvIO* bcsv){
 	if(!mInitialized) return false;
 
-	GCsize outSize = gcSaveArchive(archive, NULL);
-	GCuint8* archiveOut = new GCuint8[outSize];
-	GCuint8* archiveCmp = new GCuint8[outSize];
+	if(!bcsv->IsDirty()) return true;
 
-	gcSaveArchive(archive, archiveOut);
-	// TODO: Add option to save compressed for if we want to save a yaz0 compressed file
-	GCsize cmpSize = gcYay0Compress(&mResManagerContext, archiveOut, archiveCmp, outSize);
-	
-	std::ofstream fileStream;
-	fileStream.open(path, std::ios::binary | std::ios::out);
-	fileStream.write((const char*)archiveCmp, cmpSize);
-	fileStream.close();
+	// Small edits that don't add strings are copied straight over the existing entries.
+	uint8_t* data = archive->GetWritableData(file);
+	if(data == nullptr) return false;
+	if(bcsv->PatchInPlace(data, file->size)) return true;
+
+	std::vector<uint8_t> newData;
+	if(!bcsv->Save(newData)) return false;
+
+	if(!ReplaceArchiveFileData(archive, file, newData.data(), newData.size())) return false;
+
+	// The rebuilt file has a new string table, so reload to keep later patches in sync with it.
+	bStream::CMemoryStream stream((uint8_t*)file->data, file->size, bStream::Endianess::Big, bStream::OpenMode::In);
+	return bcsv->Load(&stream);
+}
+
+bool SResUtility::WriteFileAtomic(const std::filesystem::path& path, const uint8_t* data, size_t size)
+{
+	std::filesystem::path tempPath = path;
+	tempPath += fmt::format(".{0}.tmp", std::hash<std::thread::id>()(std::this_thread::get_id()));
+
+	FILE* file = fopen(tempPath.string().c_str(), "wb");
+	if (file == nullptr)
+	{
+		printf("Error opening file \"%s\" for writing\n", tempPath.string().c_str());
+		return false;
+	}
+
+	bool written = fwrite(data, 1, size, file) == size && fflush(file) == 0;
+	// Make sure the data is on disk before the rename can be.
+#ifdef CAMMIE_HAS_MMAP
+	written = written && fsync(fileno(file)) == 0;
+#elif defined(_WIN32)
+	written = written && _commit(_fileno(file)) == 0;
+#endif
+	written = fclose(file) == 0 && written;
+
+	std::error_code ec;
+	if (!written)
+	{
+		printf("Error writing file \"%s\"\n", tempPath.string().c_str());
+		std::filesystem::remove(tempPath, ec);
+		return false;
+	}
+
+#if defined(_WIN32)
+	// Write-through so the rename is on disk too by the time this returns.
+	if (!MoveFileExW(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+		ec = std::error_code((int)GetLastError(), std::system_category());
+#else
+	std::filesystem::rename(tempPath, path, ec);
+#endif
+	if (ec)
+	{
+		printf("Error replacing file \"%s\": %s\n", path.string().c_str(), ec.message().c_str());
+		std::filesystem::remove(tempPath, ec);
+		return false;
+	}
+
+#ifdef CAMMIE_HAS_MMAP
+	// And the rename itself, which lives in the directory.
+	std::filesystem::path dirPath = path.has_parent_path() ? path.parent_path() : std::filesystem::path(".");
+	int dirFd = open(dirPath.string().c_str(), O_RDONLY);
+	if (dirFd >= 0)
+	{
+		fsync(dirFd);
+		close(dirFd);
+	}
+#endif
+
+	return true;
+}
+
+bool SResUtility::SGCResourceManager::CommitSave(const std::string& path, uint64_t sequence, const std::vector<uint8_t>& data)
+{
+	std::lock_guard<std::mutex> lock(mCommitMutex);
+
+	uint64_t& committed = mCommittedSaves[path];
+	if (committed > sequence)
+		return true;
 
-	delete archiveOut;
-	delete archiveCmp;
+	if (!WriteFileAtomic(path, data.data(), data.size()))
+		return false;
 
+	committed = sequence;
 	return true;
 }
 
+bool SResUtility::SGCResourceManager::SaveArchiveCompressed(const char* path, SArchive* archive)
+{
+	return SaveArchiveCompressed(path, archive, Options.mSaveFormat, Options.mSaveLevel);
+}
+
+bool SResUtility::SGCResourceManager::SaveArchiveCompressed(const char* path, SArchive* archive, ECompressionFormat format, ECompressionLevel level)
+{
+	if(!mInitialized || !archive->IsLoaded()) return false;
+
+	uint64_t sequence = mNextSaveSequence++;
+
+	GCsize outSize = gcSaveArchive(&archive->mArchive, NULL);
+	std::vector<uint8_t> archiveOut(outSize);
+	gcSaveArchive(&archive->mArchive, archiveOut.data());
+
+	std::vector<uint8_t> archiveCmp;
+	SCompression::Compress(format, archiveOut.data(), archiveOut.size(), archiveCmp, level);
+
+	std::error_code ec;
+	return CommitSave(std::filesystem::absolute(path, ec).lexically_normal().string(), sequence, archiveCmp);
+}
+
+bool SResUtility::SGCResourceManager::SaveArchiveCompressedAsync(const char* path, SArchive* archive)
+{
+	return SaveArchiveCompressedAsync(path, archive, Options.mSaveFormat, Options.mSaveLevel);
+}
+
+bool SResUtility::SGCResourceManager::SaveArchiveCompressedAsync(const char* path, SArchive* archive, ECompressionFormat format, ECompressionLevel level)
+{
+	if(!mInitialized || !archive->IsLoaded()) return false;
+
+	// Serializing is quick next to compressing, and once it's done the archive is free to change.
+	GCsize outSize = gcSaveArchive(&archive->mArchive, NULL);
+	std::vector<uint8_t> archiveOut(outSize);
+	gcSaveArchive(&archive->mArchive, archiveOut.data());
+
+	std::error_code ec;
+	std::unique_ptr<SSaveJob> job = std::make_unique<SSaveJob>();
+	job->Path = std::filesystem::absolute(path, ec).lexically_normal().string();
+	job->Sequence = mNextSaveSequence++;
+
+	SSaveJob* jobPtr = job.get();
+	jobPtr->Worker = std::thread(&SGCResourceManager::RunSaveJob, this, jobPtr, std::move(archiveOut), format, level);
+
+	std::lock_guard<std::mutex> lock(mSaveJobMutex);
+	mSaveJobs.push_back(std::move(job));
+
+	return true;
+}
+
+void SResUtility::SGCResourceManager::RunSaveJob(SSaveJob* job, std::vector<uint8_t> archiveData, ECompressionFormat format, ECompressionLevel level)
+{
+	std::vector<uint8_t> archiveCmp;
+	SCompression::Compress(format, archiveData.data(), archiveData.size(), archiveCmp, level);
+
+	archiveData.clear();
+	archiveData.shrink_to_fit();
+
+	job->State = ESaveState::Writing;
+	bool saved = CommitSave(job->Path, job->Sequence, archiveCmp);
+
+	job->FinishTime = std::chrono::steady_clock::now();
+	job->State = saved ? ESaveState::Done : ESaveState::Failed;
+}
+
+bool SResUtility::SGCResourceManager::IsSaving()
+{
+	std::lock_guard<std::mutex> lock(mSaveJobMutex);
+	for (const std::unique_ptr<SSaveJob>& job : mSaveJobs)
+	{
+		if (job->State == ESaveState::Compressing || job->State == ESaveState::Writing)
+			return true;
+	}
+
+	return false;
+}
+
+void SResUtility::SGCResourceManager::RenderSaveStatus()
+{
+	std::lock_guard<std::mutex> lock(mSaveJobMutex);
+
+	auto now = std::chrono::steady_clock::now();
+	for (auto job = mSaveJobs.begin(); job != mSaveJobs.end();)
+	{
+		SSaveJob* saveJob = job->get();
+		std::string name = std::filesystem::path(saveJob->Path).filename().string();
+
+		switch (saveJob->State)
+		{
+			case ESaveState::Compressing: ImGui::Text(fmt::format("Compressing {0}...", name).data()); break;
+			case ESaveState::Writing: ImGui::Text(fmt::format("Writing {0}...", name).data()); break;
+			case ESaveState::Done: ImGui::Text(fmt::format("Saved {0}", name).data()); break;
+			case ESaveState::Failed: ImGui::Text(fmt::format("Failed to save {0}", name).data()); break;
+		}
+
+		bool finished = saveJob->State == ESaveState::Done || saveJob->State == ESaveState::Failed;
+
+		// Finished saves stay up for a few seconds so there's time to read them, failures for longer.
+		auto shownFor = saveJob->State == ESaveState::Failed ? std::chrono::seconds(10) : std::chrono::seconds(3);
+		if (finished && now - saveJob->FinishTime > shownFor)
+		{
+			saveJob->Worker.join();
+			job = mSaveJobs.erase(job);
+		}
+		else
+		{
+			job++;
+		}
+	}
+}
+
+SResUtility::SGCResourceManager::~SGCResourceManager()
+{
+	// Let any save in progress finish, the user expects it on disk.
+	for (std::unique_ptr<SSaveJob>& job : mSaveJobs)
+	{
+		if (job->Worker.joinable())
+			job->Worker.join();
+	}
+
+	// Freeing an archive touches the archive set and shared buffer maps, so every archive has to go
+	// while they're still alive rather than whenever the member holding it is torn down.
+	ClearArchiveCache();
+
+	std::vector<SArchive*> remaining;
+	{
+		std::lock_guard<std::mutex> lock(mArchiveMutex);
+		remaining.assign(mArchives.begin(), mArchives.end());
+	}
+
+	for (SArchive* archive : remaining)
+		archive->Close();
+}
+
 void SResUtility::SOptions::LoadOptions(){
 	auto optionsPath = std::filesystem::current_path() / "settings.ini";
 	if(std::filesystem::exists(optionsPath)){
@@ -129,8 +1274,45 @@ void SResUtility::SOptions::LoadOptions(){
 
 		const char* path = ini_get(config, "settings", "object_dir");
 		if(path != nullptr) mObjectDir = std::filesystem::path(path);
+
+		const char* fastDecompress = ini_get(config, "settings", "fast_decompress");
+		if(fastDecompress != nullptr) mFastDecompression = atoi(fastDecompress) != 0;
+
+		const char* saveFormat = ini_get(config, "settings", "save_format");
+		if(saveFormat != nullptr) mSaveFormat = strcmp(saveFormat, "yaz0") == 0 ? ECompressionFormat::Yaz0 : ECompressionFormat::Yay0;
+
+		const char* saveLevel = ini_get(config, "settings", "save_level");
+		if(saveLevel != nullptr) mSaveLevel = (ECompressionLevel)std::clamp(atoi(saveLevel), 0, 2);
+
+		const char* cacheArchives = ini_get(config, "settings", "cache_archives");
+		if(cacheArchives != nullptr) mCacheArchives = atoi(cacheArchives) != 0;
+
+		const char* cacheBudget = ini_get(config, "settings", "cache_budget_mb");
+		if(cacheBudget != nullptr) mCacheBudgetMB = std::max(atoi(cacheBudget), 1);
+
+		const char* archiveCacheSize = ini_get(config, "settings", "archive_cache_mb");
+		if(archiveCacheSize != nullptr) mArchiveCacheMB = std::max(atoi(archiveCacheSize), 0);
+
+		const char* dedupFiles = ini_get(config, "settings", "dedup_files");
+		if(dedupFiles != nullptr) mDeduplicateFiles = atoi(dedupFiles) != 0;
+
+		const char* modelCacheSize = ini_get(config, "settings", "model_cache_mb");
+		if(modelCacheSize != nullptr) mModelCacheMB = std::max(atoi(modelCacheSize), 0);
 		ini_free(config);
 	}
+
+	GCResourceManager.SetUseFastDecompressor(mFastDecompression);
+	GCResourceManager.SetArchiveCacheBudget((size_t)mArchiveCacheMB * 1024 * 1024);
+	GCResourceManager.SetDeduplicateFiles(mDeduplicateFiles);
+	ApplyCacheOptions();
+}
+
+void SResUtility::SOptions::ApplyCacheOptions(){
+	if(mCacheArchives){
+		GCResourceManager.SetCacheDirectory(std::filesystem::current_path() / "cache", (size_t)mCacheBudgetMB * 1024 * 1024);
+	} else {
+		GCResourceManager.SetCacheDirectory({}, 0);
+	}
 }
 
 void SResUtility::SOptions::RenderOptionMenu(){
@@ -144,9 +1326,54 @@ void SResUtility::SOptions::RenderOptionMenu(){
 			mSelectRootDialogOpen = true;
 		}
 
+		if(ImGui::Checkbox("Fast Decompression", &mFastDecompression)){
+			GCResourceManager.SetUseFastDecompressor(mFastDecompression);
+		}
+
+		// Keeps decompressed archives on disk so reopening a galaxy skips decompression.
+		if(ImGui::Checkbox("Cache Decompressed Archives", &mCacheArchives)){
+			ApplyCacheOptions();
+		}
+
+		if(mCacheArchives){
+			if(ImGui::InputInt("Cache Size (MB)", &mCacheBudgetMB)){
+				mCacheBudgetMB = std::max(mCacheBudgetMB, 1);
+				ApplyCacheOptions();
+			}
+		}
+
+		// Loaded archives kept in memory between galaxies, mostly object models.
+		if(ImGui::InputInt("Archive Memory (MB)", &mArchiveCacheMB)){
+			mArchiveCacheMB = std::max(mArchiveCacheMB, 0);
+			GCResourceManager.SetArchiveCacheBudget((size_t)mArchiveCacheMB * 1024 * 1024);
+		}
+		// Identical files in different archives share one copy, for when lots of galaxies are open at once.
+		if(ImGui::Checkbox("Share Identical Files", &mDeduplicateFiles)){
+			GCResourceManager.SetDeduplicateFiles(mDeduplicateFiles);
+		}
+		GCResourceManager.RenderArchiveCacheStats();
+
+		// Objects shared between galaxies aren't rebuilt when switching, as long as they fit.
+		if(ImGui::InputInt("Model Memory (MB)", &mModelCacheMB)){
+			mModelCacheMB = std::max(mModelCacheMB, 0);
+		}
+
+		const char* formatNames[] = { "Yaz0", "Yay0" };
+		int saveFormat = (int)mSaveFormat;
+		if(ImGui::Combo("Archive Compression", &saveFormat, formatNames, IM_ARRAYSIZE(formatNames))){
+			mSaveFormat = (ECompressionFormat)saveFormat;
+		}
+
+		// Fast is good enough while iterating on a galaxy, Max is for release builds.
+		const char* levelNames[] = { "Fast", "Normal", "Max" };
+		int saveLevel = (int)mSaveLevel;
+		if(ImGui::Combo("Compression Level", &saveLevel, levelNames, IM_ARRAYSIZE(levelNames))){
+			mSaveLevel = (ECompressionLevel)saveLevel;
+		}
+
 		if(ImGui::Button("Save")){
 			std::ofstream settingsFile(std::filesystem::current_path() / "settings.ini");
-			settingsFile << fmt::format("[settings]\nobject_dir={0}", mObjectDir.string());
+			settingsFile << fmt::format("[settings]\nobject_dir={0}\nfast_decompress={1}\nsave_format={2}\nsave_level={3}\ncache_archives={4}\ncache_budget_mb={5}\narchive_cache_mb={6}\ndedup_files={7}\nmodel_cache_mb={8}", mObjectDir.string(), mFastDecompression ? 1 : 0, mSaveFormat == ECompressionFormat::Yaz0 ? "yaz0" : "yay0", (int)mSaveLevel, mCacheArchives ? 1 : 0, mCacheBudgetMB, mArchiveCacheMB, mDeduplicateFiles ? 1 : 0, mModelCacheMB);
 			settingsFile.close();
 			ImGui::CloseCurrentPopup();
 		}
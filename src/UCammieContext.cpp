@@ -135,8 +135,6 @@ UCammieContext::UCammieContext(){
 	mBillboardManager.mBillboards[1].Texture = 1;
 	mBillboardManager.mBillboards[1].SpriteSize = 204800;
 
-	GCResourceManager.Init();
-
 	ImGuiIO& io = ImGui::GetIO();
     io.Fonts->AddFontFromFileTTF((std::filesystem::current_path() / "res/NotoSansJP-Regular.otf").string().c_str(), 16.0f, NULL, io.Fonts->GetGlyphRangesJapanese());
 	io.ConfigFlags |= ImGuiConfigFlags_DockingEnable;
@@ -379,6 +377,9 @@ void UCammieContext::RenderMenuBar() {
 		ImGui::EndMenu();
 	}
 
+	// Progress of any archives being saved in the background.
+	GCResourceManager.RenderSaveStatus();
+
 	ImGui::EndMainMenuBar();
 
 	if (bIsFileDialogOpen) {
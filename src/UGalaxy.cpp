@@ -1,8 +1,41 @@
 #include "UGalaxy.hpp"
+#include "io/BcsvSchema.hpp"
 #include <glm/gtc/type_ptr.hpp>
 #include "imgui.h"
-
-static std::map<std::string, std::shared_ptr<J3DModelData>> ModelCache;
+#include <future>
+#include <chrono>
+
+struct SObjInfoRow {
+	std::string_view Name;
+	float PosX, PosY, PosZ;
+	float DirX, DirY, DirZ;
+	float ScaleX, ScaleY, ScaleZ;
+};
+
+using SObjInfoSchema = SBcsvSchema<SObjInfoRow,
+	SBcsvField<"name", &SObjInfoRow::Name>,
+	SBcsvField<"pos_x", &SObjInfoRow::PosX>, SBcsvField<"pos_y", &SObjInfoRow::PosY>, SBcsvField<"pos_z", &SObjInfoRow::PosZ>,
+	SBcsvField<"dir_x", &SObjInfoRow::DirX>, SBcsvField<"dir_y", &SObjInfoRow::DirY>, SBcsvField<"dir_z", &SObjInfoRow::DirZ>,
+	SBcsvField<"scale_x", &SObjInfoRow::ScaleX>, SBcsvField<"scale_y", &SObjInfoRow::ScaleY>, SBcsvField<"scale_z", &SObjInfoRow::ScaleZ>
+>;
+
+struct SStageObjInfoRow {
+	std::string Name;
+	float PosX, PosY, PosZ;
+	float DirX, DirY, DirZ;
+};
+
+using SStageObjInfoSchema = SBcsvSchema<SStageObjInfoRow,
+	SBcsvField<"name", &SStageObjInfoRow::Name>,
+	SBcsvField<"pos_x", &SStageObjInfoRow::PosX>, SBcsvField<"pos_y", &SStageObjInfoRow::PosY>, SBcsvField<"pos_z", &SStageObjInfoRow::PosZ>,
+	SBcsvField<"dir_x", &SStageObjInfoRow::DirX>, SBcsvField<"dir_y", &SStageObjInfoRow::DirY>, SBcsvField<"dir_z", &SStageObjInfoRow::DirZ>
+>;
+
+struct SZoneListRow {
+	std::string ZoneName;
+};
+
+using SZoneListSchema = SBcsvSchema<SZoneListRow, SBcsvField<"ZoneName", &SZoneListRow::ZoneName>>;
 
 void GalaxySort(J3DRendering::SortFunctionArgs packets) {
     std::sort(
@@ -48,77 +81,187 @@ glm::mat4 computeTransform(glm::vec3 scale, glm::vec3 dir, glm::vec3 pos){
 }
 
 CGalaxyRenderer::~CGalaxyRenderer(){
-	ModelCache.clear();
+	mModelCache.clear();
+	mModelLru.clear();
 }
 
-void CGalaxyRenderer::LoadModel(std::string modelName){
-	std::filesystem::path modelPath = std::filesystem::path(Options.mObjectDir) / (modelName + ".arc");
-	
-	if(std::filesystem::exists(modelPath)){
-		GCarchive modelArc;
-		GCResourceManager.LoadArchive(modelPath.string().c_str(), &modelArc);
-		for (GCarcfile* file = modelArc.files; file < modelArc.files + modelArc.filenum; file++){
-			if(std::filesystem::path(file->name).extension() == ".bdl"){
-				J3DModelLoader Loader;
-				bStream::CMemoryStream modelStream((uint8_t*)file->data, file->size, bStream::Endianess::Big, bStream::OpenMode::In);
-				
-				auto data = std::make_shared<J3DModelData>();
-				data = Loader.Load(&modelStream, NULL);
-				ModelCache.insert({modelName, data});
+// Time spent each frame turning model files that have finished loading into models.
+static constexpr std::chrono::microseconds ModelUploadBudget { 4000 };
+
+void CGalaxyRenderer::RequestModel(uint32_t modelId){
+	if(!mRequestedModels.insert(modelId).second) return;
+
+	auto cached = mModelCache.find(modelId);
+	if(cached != mModelCache.end()){
+		mModelLru.splice(mModelLru.begin(), mModelLru, cached->second.LruPos);
+		mModelCacheHits++;
+		return;
+	}
+
+	mModelCacheMisses++;
+
+	// The interner isn't thread safe, so the worker gets its own copy of the name.
+	std::string modelName = mModelNames.GetString(modelId);
+	if(!mObjectDir.Contains(modelName)) return;
+
+	std::filesystem::path modelPath = mObjectDir.GetArchivePath(modelName);
+
+	mModelsInFlight++;
+	mLoadPool.Submit([this, modelId, modelName, modelPath](){
+		SPendingModel pending { modelId, {} };
+
+		// Object archives are shared by most galaxies, so they stay in the archive cache between loads.
+		std::shared_ptr<SResUtility::SArchive> modelArc = GCResourceManager.AcquireArchive(modelPath.string().c_str());
+		const GCarcfile* file = nullptr;
+
+		if(modelArc != nullptr){
+			file = modelArc->Find(modelName + ".bdl");
+
+			// A few archives name their model differently, take whatever model is in the root.
+			if(file == nullptr){
+				for(const GCarcfile* rootFile : modelArc->GetChildren("")){
+					if(std::filesystem::path(rootFile->name).extension() == ".bdl"){
+						file = rootFile;
+						break;
+					}
+				}
 			}
 		}
-	} else {
-		std::cout << "Couldn't find model " << modelName << std::endl;
+
+		// Copied out so the archive can be evicted before the model is built.
+		if(file != nullptr && file->data != nullptr){
+			pending.Data.assign((uint8_t*)file->data, (uint8_t*)file->data + file->size);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mPendingModelMutex);
+			mPendingModels.push_back(std::move(pending));
+		}
+		mModelsInFlight--;
+	});
+}
+
+void CGalaxyRenderer::UploadPendingModels(){
+	auto start = std::chrono::steady_clock::now();
+
+	// At least one model is built every frame, however long it takes.
+	do {
+		SPendingModel pending;
+		{
+			std::lock_guard<std::mutex> lock(mPendingModelMutex);
+			if(mPendingModels.empty()) return;
+
+			pending = std::move(mPendingModels.front());
+			mPendingModels.pop_front();
+		}
+
+		if(pending.Data.empty() || mModelCache.contains(pending.ModelId)) continue;
+
+		J3DModelLoader Loader;
+		bStream::CMemoryStream modelStream(pending.Data.data(), pending.Data.size(), bStream::Endianess::Big, bStream::OpenMode::In);
+		std::shared_ptr<J3DModelData> model = Loader.Load(&modelStream, NULL);
+		if(model == nullptr) continue;
+
+		mModelLru.push_front(pending.ModelId);
+		// The parsed model and its GPU buffers are roughly twice the size of the file.
+		SModelCacheEntry entry { model, pending.Data.size() * 2, mModelLru.begin() };
+		mModelCacheBytes += entry.Bytes;
+		mModelCache.insert({pending.ModelId, entry});
+		EvictModels();
+	} while(std::chrono::steady_clock::now() - start < ModelUploadBudget);
+}
+
+void CGalaxyRenderer::EvictModels(){
+	size_t budget = (size_t)Options.mModelCacheMB * 1024 * 1024;
+
+	// Models placed in the current galaxy are never evicted, even if they alone go over budget.
+	auto it = mModelLru.end();
+	while(mModelCacheBytes > budget && it != mModelLru.begin()){
+		--it;
+		if(mRequestedModels.contains(*it)) continue;
+
+		auto entry = mModelCache.find(*it);
+		mModelCacheBytes -= entry->second.Bytes;
+		mModelCache.erase(entry);
+		it = mModelLru.erase(it);
 	}
 }
 
-std::vector<std::pair<std::string, glm::mat4>> CGalaxyRenderer::LoadZoneLayer(GCarchive* zoneArchive, GCarcfile* layerDir, bool isMainGalaxyZone){
-	std::vector<std::pair<std::string, glm::mat4>> objects;
-	for (GCarcfile* layer_file = &zoneArchive->files[zoneArchive->dirs[layerDir->size].fileoff]; layer_file < &zoneArchive->files[zoneArchive->dirs[layerDir->size].fileoff] + zoneArchive->dirs[layerDir->size].filenum; layer_file++){
-		if((strcmp(layer_file->name, "stageobjinfo") == 0 || strcmp(layer_file->name, "StageObjInfo") == 0) && isMainGalaxyZone){
-			// TODO: Load this for this zone
-			//std::cout << "This should only happen once!" << std::endl;
-			
-			SBcsvIO StageObjInfo;
-			bStream::CMemoryStream StageObjInfoStream((uint8_t*)layer_file->data, (size_t)layer_file->size, bStream::Endianess::Big, bStream::OpenMode::In);
-			StageObjInfo.Load(&StageObjInfoStream);
-			for(size_t stageObjEntry = 0; stageObjEntry < StageObjInfo.GetEntryCount(); stageObjEntry++){
-				std::string zoneName = StageObjInfo.GetString(stageObjEntry, "name");
-				std::cout << "Loading StageObjInfo Entry " << zoneName << std::endl;
-				glm::vec3 position = {StageObjInfo.GetFloat(stageObjEntry, "pos_x"), StageObjInfo.GetFloat(stageObjEntry, "pos_y"), StageObjInfo.GetFloat(stageObjEntry, "pos_z")};
-				glm::vec3 rotation = {StageObjInfo.GetFloat(stageObjEntry, "dir_x"), StageObjInfo.GetFloat(stageObjEntry, "dir_y"), StageObjInfo.GetFloat(stageObjEntry, "dir_z")};
-				mZoneTransforms.insert({zoneName, computeTransform({1,1,1}, rotation, position)});
-			}
+// Everything decoded from one placement layer. Names point into the zone archive's data,
+// so the archive has to outlive this until it's been merged into the renderer.
+struct SZoneLayerData {
+	std::vector<std::pair<std::string_view, glm::mat4>> Objects;
+	std::vector<std::pair<std::string, glm::mat4>> StageTransforms;
+};
+
+// Runs on the load pool, so it mustn't touch the renderer.
+static SZoneLayerData LoadZoneLayer(SResUtility::SLazyArchive* zoneArchive, const std::string& layerPath, bool isMainGalaxyZone){
+	SZoneLayerData layer;
+
+	GCarcfile* stageObjInfoFile = zoneArchive->Find(layerPath + "/stageobjinfo");
+	// Zones are placed by the main galaxy zone's stageobjinfo, other zones' copies aren't used.
+	if(stageObjInfoFile != nullptr && stageObjInfoFile->data != nullptr && isMainGalaxyZone){
+		SBcsvIO StageObjInfo;
+		bStream::CMemoryStream StageObjInfoStream((uint8_t*)stageObjInfoFile->data, (size_t)stageObjInfoFile->size, bStream::Endianess::Big, bStream::OpenMode::In);
+		StageObjInfo.LoadView(&StageObjInfoStream);
+
+		SStageObjInfoSchema schema;
+		schema.Bind(StageObjInfo);
+
+		for(const SStageObjInfoRow& row : schema.ReadAll(StageObjInfo)){
+			glm::vec3 position = {row.PosX, row.PosY, row.PosZ};
+			glm::vec3 rotation = {row.DirX, row.DirY, row.DirZ};
+			layer.StageTransforms.push_back({row.Name, computeTransform({1,1,1}, rotation, position)});
 		}
-		if((strcmp(layer_file->name, "objinfo") == 0 || strcmp(layer_file->name, "ObjInfo") == 0) && layer_file->data != nullptr){
-			SBcsvIO ObjInfo;
-			bStream::CMemoryStream ObjInfoStream((uint8_t*)layer_file->data, (size_t)layer_file->size, bStream::Endianess::Big, bStream::OpenMode::In);
-			ObjInfo.Load(&ObjInfoStream);
-			for(size_t objEntry = 0; objEntry < ObjInfo.GetEntryCount(); objEntry++){
-				std::string modelName = ObjInfo.GetString(objEntry, "name");
-				glm::vec3 position = {ObjInfo.GetFloat(objEntry, "pos_x"), ObjInfo.GetFloat(objEntry, "pos_y"), ObjInfo.GetFloat(objEntry, "pos_z")};
-				glm::vec3 rotation = {ObjInfo.GetFloat(objEntry, "dir_x"), ObjInfo.GetFloat(objEntry, "dir_y"), ObjInfo.GetFloat(objEntry, "dir_z")};
-				glm::vec3 scale = {ObjInfo.GetFloat(objEntry, "scale_x"), ObjInfo.GetFloat(objEntry, "scale_y"), ObjInfo.GetFloat(objEntry, "scale_z")};
-				if(Options.mObjectDir != "" && !ModelCache.contains(modelName)){
-					LoadModel(modelName);
-				}
-				objects.push_back({modelName, computeTransform(scale, rotation, position)});
+	}
 
-			}
+	GCarcfile* objInfoFile = zoneArchive->Find(layerPath + "/objinfo");
+	if(objInfoFile != nullptr && objInfoFile->data != nullptr){
+		SBcsvIO ObjInfo;
+		bStream::CMemoryStream ObjInfoStream((uint8_t*)objInfoFile->data, (size_t)objInfoFile->size, bStream::Endianess::Big, bStream::OpenMode::In);
+		ObjInfo.LoadView(&ObjInfoStream);
+
+		SObjInfoSchema schema;
+		schema.Bind(ObjInfo);
+
+		std::vector<SObjInfoRow> rows = schema.ReadAll(ObjInfo);
+		layer.Objects.reserve(rows.size());
+
+		for(SObjInfoRow& row : rows){
+			glm::vec3 position = {row.PosX, row.PosY, row.PosZ};
+			glm::vec3 rotation = {row.DirX, row.DirY, row.DirZ};
+			glm::vec3 scale = {row.ScaleX, row.ScaleY, row.ScaleZ};
+			layer.Objects.push_back({row.Name, computeTransform(scale, rotation, position)});
 		}
 	}
-	return objects;
+
+	return layer;
 }
 
+// A zone archive opened on the load pool, with its layers being decoded.
+struct SZoneLoad {
+	std::string Name;
+	std::shared_ptr<SResUtility::SLazyArchive> Archive;
+	std::vector<std::pair<std::string, std::future<SZoneLayerData>>> Layers;
+};
+
 void CGalaxyRenderer::LoadGalaxy(std::filesystem::path galaxy_path, bool isGalaxy2){
 
 	J3DRendering::SetSortFunction(GalaxySort);
 
 	mZones.clear();
+	mLayers.clear();
+	mObjectModels.clear();
+	mObjectTransforms.clear();
+	mObjectZones.clear();
+	mObjectLayers.clear();
+	mObjectVisible.clear();
 	mZoneTransforms.clear();
-	ModelCache.clear();
-
-	GCarchive scenarioArchive;
+	// Cached models are kept, most objects are shared with the galaxy loaded before.
+	mRequestedModels.clear();
+	// Picks up object archives added since the last galaxy was loaded.
+	mObjectDir.SetDirectory(Options.mObjectDir);
+	mObjectDir.Refresh();
 
 	std::string name = (galaxy_path / std::string(".")).parent_path().filename().string();
 
@@ -129,83 +272,162 @@ void CGalaxyRenderer::LoadGalaxy(std::filesystem::path galaxy_path, bool isGalax
 		return;
 	}
 
-    GCResourceManager.LoadArchive((galaxy_path / (name + "Scenario.arc")).string().c_str(), &scenarioArchive);
+	std::shared_ptr<SResUtility::SArchive> scenarioArchive = GCResourceManager.AcquireArchive((galaxy_path / (name + "Scenario.arc")).string().c_str());
+	if(scenarioArchive == nullptr) return;
 
-    for(GCarcfile* file = scenarioArchive.files; file < scenarioArchive.files + scenarioArchive.filenum; file++){
-        
-        // Load Scenarios and cameras. Todo!
+	// Load Scenarios and cameras. Todo!
 
-		/*
-        if(strcmp(file->name, "scenariodata.bcsv") == 0){
-            SBcsvIO ScenarioData;
-            bStream::CMemoryStream ScenarioDataStream((uint8_t*)file->data, (size_t)file->size, bStream::Endianess::Big, bStream::OpenMode::In);
-            ScenarioData.Load(&ScenarioDataStream);
-            for(size_t entry = 0; entry < ScenarioData.GetEntryCount(); entry++){
+	/*
+	const GCarcfile* scenarioDataFile = scenarioArchive->Find("scenariodata.bcsv");
+	if(scenarioDataFile != nullptr){
+		SBcsvIO ScenarioData;
+		bStream::CMemoryStream ScenarioDataStream((uint8_t*)scenarioDataFile->data, (size_t)scenarioDataFile->size, bStream::Endianess::Big, bStream::OpenMode::In);
+		ScenarioData.Load(&ScenarioDataStream);
+		for(size_t entry = 0; entry < ScenarioData.GetEntryCount(); entry++){
 
-            }
-        }
-		*/
+		}
+	}
+	*/
 
-        // Load all zones and all zone layers
+	// Load all zones and all zone layers
 
-        if(strcmp(file->name, "zonelist.bcsv") == 0 || strcmp(file->name, "ZoneList.bcsv") == 0){
-            SBcsvIO ZoneData;
-            bStream::CMemoryStream ZoneDataStream((uint8_t*)file->data, (size_t)file->size, bStream::Endianess::Big, bStream::OpenMode::In);
-            ZoneData.Load(&ZoneDataStream);
-            for(size_t entry = 0; entry < ZoneData.GetEntryCount(); entry++){
-				std::filesystem::path zonePath = (galaxy_path.parent_path() / (ZoneData.GetString(entry, "ZoneName") + ".arc"));
+	const GCarcfile* zoneListFile = scenarioArchive->Find("zonelist.bcsv");
+	if(zoneListFile != nullptr){
+		SBcsvIO ZoneData;
+		bStream::CMemoryStream ZoneDataStream((uint8_t*)zoneListFile->data, (size_t)zoneListFile->size, bStream::Endianess::Big, bStream::OpenMode::In);
+		ZoneData.LoadView(&ZoneDataStream);
 
-				if(isGalaxy2){
-					zonePath = (galaxy_path.parent_path() / ZoneData.GetString(entry, "ZoneName") / (ZoneData.GetString(entry, "ZoneName") + "Map.arc"));
+		SZoneListSchema schema;
+		schema.Bind(ZoneData);
+
+		// Zone archives are opened and read in parallel, then each zone's layers are decoded
+		// in parallel once its archive is in. Results are merged here in zone list order so
+		// model IDs and load order don't depend on which worker finishes first.
+		std::vector<std::pair<std::string, std::future<std::shared_ptr<SResUtility::SLazyArchive>>>> archives;
+
+		for(const SZoneListRow& row : schema.ReadAll(ZoneData)){
+			const std::string& zoneName = row.ZoneName;
+			std::filesystem::path zonePath = (galaxy_path.parent_path() / (zoneName + ".arc"));
+
+			if(isGalaxy2){
+				zonePath = (galaxy_path.parent_path() / zoneName / (zoneName + "Map.arc"));
+			}
+
+			if(!std::filesystem::exists(zonePath)){
+				std::cout << "Couldn't open zone archive " << zonePath << std::endl;
+				// Nothing's been merged yet, so the scene is left empty. Zones already queued are
+				// waited on so their archives are closed before the next load starts.
+				for(auto& [queuedName, queuedArchive] : archives){
+					queuedArchive.wait();
 				}
-				
-				if(!std::filesystem::exists(zonePath)){
-					std::cout << "Couldn't open zone archive " << zonePath << std::endl;
-					gcFreeArchive(&scenarioArchive);
-					return;
-				} else {
-					std::cout << "Loading zone archive " << zonePath << std::endl;
-                }
-
-				GCarchive zoneArchive;
-				GCResourceManager.LoadArchive(zonePath.string().c_str(), &zoneArchive);
-				
-				std::map<std::string, std::pair<std::vector<std::pair<std::string, glm::mat4>>, bool>> zone;
-
-				for (GCarcfile* file = zoneArchive.files; file < zoneArchive.files + zoneArchive.filenum; file++){
-					if(file->parent != nullptr && (strcmp(file->parent->name, "placement") == 0 || strcmp(file->parent->name, "Placement") == 0) && (file->attr & 0x02) && strcmp(file->name, ".") != 0 && strcmp(file->name, "..") != 0){
-						std::cout << "Loading zone " << ZoneData.GetString(entry, "ZoneName") << " layer " << file->name << std::endl;
-						auto layer = LoadZoneLayer(&zoneArchive, file, (ZoneData.GetString(entry, "ZoneName") == name));
-						zone.insert({file->name, {layer, true}});
-					}
+				return;
+			} else {
+				std::cout << "Loading zone archive " << zonePath << std::endl;
+			}
+
+			// Only the placement files are read, so the rest of the zone is never copied out.
+			archives.push_back({zoneName, mLoadPool.Submit([zonePath]() -> std::shared_ptr<SResUtility::SLazyArchive> {
+				auto zoneArchive = std::make_shared<SResUtility::SLazyArchive>();
+				if(!GCResourceManager.LoadArchiveLazy(zonePath.string().c_str(), zoneArchive.get())) return nullptr;
+				return zoneArchive;
+			})});
+		}
+
+		std::vector<SZoneLoad> zoneLoads;
+		zoneLoads.reserve(archives.size());
+
+		for(auto& [zoneName, archive] : archives){
+			SZoneLoad& zoneLoad = zoneLoads.emplace_back();
+			zoneLoad.Name = zoneName;
+			zoneLoad.Archive = archive.get();
+			if(zoneLoad.Archive == nullptr) continue;
+
+			bool isMainGalaxyZone = (zoneName == name);
+			for(GCarcfile* layerDir : zoneLoad.Archive->GetChildren("jmp/placement")){
+				if(!(layerDir->attr & 0x02)) continue;
+
+				std::string layerPath = std::string("jmp/placement/") + layerDir->name;
+				SResUtility::SLazyArchive* zoneArchive = zoneLoad.Archive.get();
+				zoneLoad.Layers.push_back({layerDir->name, mLoadPool.Submit([zoneArchive, layerPath, isMainGalaxyZone](){
+					return LoadZoneLayer(zoneArchive, layerPath, isMainGalaxyZone);
+				})});
+			}
+		}
+
+		// Interning stays on this thread; models are read on the pool and built in RenderGalaxy.
+		for(SZoneLoad& zoneLoad : zoneLoads){
+			if(zoneLoad.Archive == nullptr) continue;
+
+			uint16_t zoneIndex = (uint16_t)mZones.size();
+			mZones.push_back({zoneLoad.Name, (uint32_t)mLayers.size(), 0, false});
+
+			for(auto& [layerName, layerFuture] : zoneLoad.Layers){
+				std::cout << "Loading zone " << zoneLoad.Name << " layer " << layerName << std::endl;
+				SZoneLayerData layerData = layerFuture.get();
+
+				for(auto& [stageName, transform] : layerData.StageTransforms){
+					std::cout << "Loading StageObjInfo Entry " << stageName << std::endl;
+					mZoneTransforms.insert({stageName, transform});
 				}
-				
-				mZones.insert({ZoneData.GetString(entry, "ZoneName"), zone});
 
-				gcFreeArchive(&zoneArchive);
-            }
-        }
-    }
-
-	for(auto& [zoneName, zone] : mZones){
-		for(auto& [layerName, layer] : zone){
-			if(!layer.second) continue; //layer not set to visible
-			for(auto& object : layer.first){
-				if(mZoneTransforms.count(zoneName) != 0 && ModelCache.count(object.first) != 0){
-					object.second = mZoneTransforms.at(zoneName) * object.second;
+				uint16_t layerIndex = (uint16_t)mLayers.size();
+				mLayers.push_back({layerName, (uint32_t)mObjectModels.size(), (uint32_t)layerData.Objects.size(), true});
+				mZones.back().LayerCount++;
+
+				for(auto& [objectName, transform] : layerData.Objects){
+					uint32_t modelId = mModelNames.Intern(objectName);
+					if(Options.mObjectDir != ""){
+						RequestModel(modelId);
+					}
+					mObjectModels.push_back(modelId);
+					mObjectTransforms.push_back(glm::mat4x3(transform));
+					mObjectZones.push_back(zoneIndex);
+					mObjectLayers.push_back(layerIndex);
 				}
 			}
 		}
+
+		// Models only the previous galaxy used can go now, if the cache is over budget.
+		EvictModels();
 	}
 
-	gcFreeArchive(&scenarioArchive);
+	// Zone transforms only exist once every zone is in, the main zone may come last.
+	mObjectVisible.assign((mObjectModels.size() + 63) / 64, 0);
+
+	for(uint32_t zoneIndex = 0; zoneIndex < mZones.size(); zoneIndex++){
+		SSceneZone& zone = mZones[zoneIndex];
+		auto zoneTransform = mZoneTransforms.find(zone.Name);
+		zone.Placed = (zoneTransform != mZoneTransforms.end());
+
+		for(uint32_t layerIndex = zone.FirstLayer; layerIndex < zone.FirstLayer + zone.LayerCount; layerIndex++){
+			const SSceneLayer& layer = mLayers[layerIndex];
+
+			// Applied whether or not the model is in yet, most of them arrive after this.
+			if(zone.Placed){
+				for(uint32_t object = layer.FirstObject; object < layer.FirstObject + layer.ObjectCount; object++){
+					mObjectTransforms[object] = glm::mat4x3(zoneTransform->second * glm::mat4(mObjectTransforms[object]));
+				}
+			}
+
+			SetLayerVisible(layerIndex, layer.Visible);
+		}
+	}
 }
 
 void CGalaxyRenderer::RenderUI() {
-	for(auto& [zoneName, zone] : mZones){
-		if (ImGui::TreeNode(zoneName.c_str())){
-			for(auto& [layerName, layer] : zone){
-				ImGui::Checkbox(layerName.c_str(), &layer.second);
+	if(mModelsInFlight > 0){
+		ImGui::Text("Loading %u models...", mModelsInFlight.load());
+	}
+	ImGui::Text("Models: %zu cached, %.1f MB", mModelCache.size(), mModelCacheBytes / (1024.0f * 1024.0f));
+	ImGui::Text("Model Hits: %u Misses: %u", mModelCacheHits, mModelCacheMisses);
+
+	for(const SSceneZone& zone : mZones){
+		if (ImGui::TreeNode(zone.Name.c_str())){
+			for(uint32_t layerIndex = zone.FirstLayer; layerIndex < zone.FirstLayer + zone.LayerCount; layerIndex++){
+				SSceneLayer& layer = mLayers[layerIndex];
+				if(ImGui::Checkbox(layer.Name.c_str(), &layer.Visible)){
+					SetLayerVisible(layerIndex, layer.Visible);
+				}
 			}
 
 			ImGui::TreePop();
@@ -213,28 +435,38 @@ void CGalaxyRenderer::RenderUI() {
 	}
 }
 
-void CGalaxyRenderer::RenderGalaxy(float dt, USceneCamera* camera){
-
-	uint32_t objectCount = 0;
-	for(auto& [zoneName, zone] : mZones){
-		for(auto& [layerName, layer] : zone){
-			objectCount += layer.first.size();
+void CGalaxyRenderer::SetLayerVisible(uint32_t layerIndex, bool visible){
+	SSceneLayer& layer = mLayers[layerIndex];
+	layer.Visible = visible;
+	if(layer.ObjectCount == 0) return;
+
+	bool drawn = visible && mZones[mObjectZones[layer.FirstObject]].Placed;
+	for(uint32_t object = layer.FirstObject; object < layer.FirstObject + layer.ObjectCount; object++){
+		if(drawn){
+			mObjectVisible[object / 64] |= (1ull << (object % 64));
+		} else {
+			mObjectVisible[object / 64] &= ~(1ull << (object % 64));
 		}
 	}
+}
+
+void CGalaxyRenderer::RenderGalaxy(float dt, USceneCamera* camera){
+	UploadPendingModels();
 
-	mRenderables.reserve(objectCount);
+	mRenderables.reserve(mObjectModels.size());
 
-	for(auto& [zoneName, zone] : mZones){
-		for(auto& [layerName, layer] : zone){
-			if(!layer.second) continue; //layer not set to visible
-			for(auto& object : layer.first){
-				if(mZoneTransforms.count(zoneName) != 0 && ModelCache.count(object.first) != 0){
-					std::shared_ptr<J3DModelInstance> model = ModelCache.at(object.first)->GetInstance();
-					model->SetReferenceFrame(object.second);
+	// Skips over hidden objects 64 at a time.
+	for(size_t word = 0; word < mObjectVisible.size(); word++){
+		for(uint64_t bits = mObjectVisible[word]; bits != 0; bits &= bits - 1){
+			size_t object = word * 64 + std::countr_zero(bits);
 
-					mRenderables.push_back(model);
-				}
-			}
+			auto cached = mModelCache.find(mObjectModels[object]);
+			if(cached == mModelCache.end()) continue;
+
+			std::shared_ptr<J3DModelInstance> model = cached->second.Model->GetInstance();
+			model->SetReferenceFrame(glm::mat4(mObjectTransforms[object]));
+
+			mRenderables.push_back(model);
 		}
 	}
 
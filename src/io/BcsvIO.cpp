@@ -1,22 +1,27 @@
 #include "io/BcsvIO.hpp"
+#include <map>
 
-SBcsvIO::SBcsvIO() : mData(nullptr), mStringTable(nullptr)
+SBcsvIO::SBcsvIO()
 {
 
 }
 
 SBcsvIO::~SBcsvIO()
 {
-	if(mData != nullptr){
-		delete[] mData;
-	}
 
-	if(mStringTable != nullptr){
-		delete[] mStringTable;
-	}
 }
 
 bool SBcsvIO::Load(bStream::CMemoryStream* stream)
+{
+	return LoadInternal(stream, false);
+}
+
+bool SBcsvIO::LoadView(bStream::CMemoryStream* stream)
+{
+	return LoadInternal(stream, true);
+}
+
+bool SBcsvIO::LoadInternal(bStream::CMemoryStream* stream, bool borrow)
 {
 	mEntryCount = stream->readInt32();
 	mFieldCount = stream->readInt32();
@@ -26,15 +31,10 @@ bool SBcsvIO::Load(bStream::CMemoryStream* stream)
 	if (mEntrySize == 0 || mEntryStartOffset + mEntrySize * mEntryCount > stream->getSize())
 		return false;
 
-	mData = new uint8_t[mEntryCount * mEntrySize];
-
-	// Make our own copy of the entry data, since the stream will be
-	// destroyed when we're done reading.
-	memcpy(mData, stream->getBuffer() + mEntryStartOffset, mEntrySize * mEntryCount);
-
-
 	mFields.clear();
 	mFields.reserve(mFieldCount);
+	mFieldLookup.clear();
+	mFieldLookup.reserve(mFieldCount);
 
 	for (int32_t i = 0; i < mFieldCount; i++)
 	{
@@ -45,201 +45,387 @@ bool SBcsvIO::Load(bStream::CMemoryStream* stream)
 		newField.Shift = stream->readUInt8();
 		newField.Type = (EJmpFieldType)stream->readUInt8();
 
+		mFieldLookup.insert({newField.Hash, (uint32_t)mFields.size()});
 		mFields.push_back(newField);
 	}
 
-	// Head to the end of the enstries and read the string table
-	uint32_t stringTableSize = (stream->getSize() - (mEntryStartOffset + (mEntrySize * mEntryCount)));
-	mStringTable = new uint8_t[stringTableSize];
+	uint8_t* entryData = stream->getBuffer() + mEntryStartOffset;
+	size_t entryDataSize = mEntrySize * mEntryCount;
+
+	// The string table runs from the end of the entries to the end of the file
+	uint8_t* stringTable = entryData + entryDataSize;
+	mStringTableSize = stream->getSize() - (mEntryStartOffset + entryDataSize);
+
+	mIsView = borrow;
+
+	mStringOffsets.clear();
+	mStringOffsetsBuilt = false;
 
-	memcpy(mStringTable, stream->getBuffer() + mEntryStartOffset + (mEntrySize * mEntryCount), stringTableSize);
+	mDirtyRows.assign(mEntryCount, false);
+	mHasDirtyRows = false;
+	mLoadedStringTableSize = mStringTableSize;
+	mLayoutChanged = false;
+
+	if (borrow)
+	{
+		mDataStorage.clear();
+		mStringTableStorage.clear();
+
+		mData = entryData;
+		mStringTable = stringTable;
+	}
+	else
+	{
+		// Make our own copy of the entry data, since the stream will be
+		// destroyed when we're done reading.
+		mDataStorage.assign(entryData, entryData + entryDataSize);
+		mStringTableStorage.assign(stringTable, stringTable + mStringTableSize);
+
+		mData = mDataStorage.data();
+		mStringTable = mStringTableStorage.data();
+	}
 
 	return true;
 }
 
-uint32_t SBcsvIO::HashFieldName(std::string name) const
+void SBcsvIO::MakeWritable()
 {
-	uint32_t hash = 0;
+	if (!mIsView)
+		return;
 
-	for (char c : name)
-	{
-		hash *= 0x1F;
-		hash += c;
-	}
+	mDataStorage.assign(mData, mData + mEntrySize * mEntryCount);
+	mStringTableStorage.assign(mStringTable, mStringTable + mStringTableSize);
 
-	return hash;
+	mData = mDataStorage.data();
+	mStringTable = mStringTableStorage.data();
+	mIsView = false;
 }
 
-const SBcsvFieldInfo* SBcsvIO::FetchJmpFieldInfo(std::string name)
+uint32_t SBcsvIO::HashFieldName(std::string_view name) const
 {
-	const SBcsvFieldInfo* field = nullptr;
-	uint32_t nameHash = HashFieldName(name);
+	return JmpHashFieldName(name);
+}
 
-	for (const SBcsvFieldInfo& f : mFields)
+const SBcsvFieldInfo* SBcsvIO::FetchJmpFieldInfo(std::string_view name) const
+{
+	return FetchJmpFieldInfo(HashFieldName(name));
+}
+
+const SBcsvFieldInfo* SBcsvIO::FetchJmpFieldInfo(uint32_t hash) const
+{
+	auto it = mFieldLookup.find(hash);
+	if (it == mFieldLookup.end())
+		return nullptr;
+
+	return &mFields[it->second];
+}
+
+uint32_t SBcsvIO::PeekField(uint32_t entry_index, SBcsvFieldHandle field) const
+{
+	uint32_t width = JmpFieldTypeSize(field->Type);
+
+	if (entry_index >= (uint32_t)mEntryCount || field->Start + width > mEntrySize)
+		return 0;
+
+	const uint8_t* cell = mData + entry_index * mEntrySize + field->Start;
+
+	switch (width)
 	{
-		if (nameHash == f.Hash)
-		{
-			field = &f;
-			break;
-		}
+	case sizeof(uint8_t):
+		return cell[0];
+	case sizeof(uint16_t):
+		return cell[0] << 8 | cell[1];
+	default:
+		return (
+			cell[0] << 24 |
+			cell[1] << 16 |
+			cell[2] << 8 |
+			cell[3]
+		);
 	}
+}
+
+bool SBcsvIO::PokeField(uint32_t entry_index, SBcsvFieldHandle field, uint32_t value)
+{
+	uint32_t width = JmpFieldTypeSize(field->Type);
 
-	return field;
+	if (entry_index >= (uint32_t)mEntryCount || field->Start + width > mEntrySize)
+		return false;
+
+	MakeWritable();
+
+	uint8_t* cell = mData + entry_index * mEntrySize + field->Start;
+
+	for (uint32_t i = 0; i < width; i++)
+		cell[i] = (uint8_t)(value >> ((width - 1 - i) * 8));
+
+	mDirtyRows[entry_index] = true;
+	mHasDirtyRows = true;
+
+	return true;
 }
 
-const SBcsvFieldInfo* SBcsvIO::FetchJmpFieldInfo(uint32_t hash)
+bool SBcsvIO::PatchInPlace(uint8_t* file_data, size_t file_size)
 {
-	const SBcsvFieldInfo* field = nullptr;
+	if (NeedsResize() || mEntryStartOffset + (size_t)mEntrySize * mEntryCount > file_size)
+		return false;
 
-	for (const SBcsvFieldInfo& f : mFields)
+	if (!mHasDirtyRows)
+		return true;
+
+	for (int32_t entry = 0; entry < mEntryCount; entry++)
 	{
-		if (hash == f.Hash)
-		{
-			field = &f;
-			break;
-		}
+		if (!mDirtyRows[entry])
+			continue;
+
+		uint8_t* dest = file_data + mEntryStartOffset + entry * mEntrySize;
+
+		// A view may have been loaded straight from this buffer and never written to.
+		if (dest != mData + entry * mEntrySize)
+			memcpy(dest, mData + entry * mEntrySize, mEntrySize);
+
+		mDirtyRows[entry] = false;
 	}
 
-	return field;
+	mHasDirtyRows = false;
+
+	return true;
 }
 
-uint32_t SBcsvIO::PeekU32(uint32_t offset)
+uint32_t SBcsvIO::GetUnsignedInt(uint32_t entry_index, std::string_view field_name)
 {
-	if (offset >= mEntryCount * mEntrySize)
+	return GetUnsignedInt(entry_index, FetchJmpFieldInfo(field_name));
+}
+
+uint32_t SBcsvIO::GetUnsignedInt(uint32_t entry_index, SBcsvFieldHandle field)
+{
+	// If field is nullptr, we failed to find a field matching the given name.
+	if (field == nullptr)
 		return 0;
 
-	return (
-		mData[offset]     << 24 |
-		mData[offset + 1] << 16 |
-		mData[offset + 2] << 8 |
-		mData[offset + 3]
-	);
+	return (PeekField(entry_index, field) & field->Bitmask) >> field->Shift;
 }
 
-int32_t SBcsvIO::PeekS32(uint32_t offset)
+int32_t SBcsvIO::GetSignedInt(uint32_t entry_index, std::string_view field_name)
 {
-	return (int32_t)PeekU32(offset);
+	return GetSignedInt(entry_index, FetchJmpFieldInfo(field_name));
 }
 
-float SBcsvIO::PeekF32(uint32_t offset)
+int32_t SBcsvIO::GetSignedInt(uint32_t entry_index, uint32_t field_hash)
 {
-	union {
-		uint32_t u32;
-		float f32;
-	} converter;
-
-	converter.u32 = PeekU32(offset);
-	return converter.f32;
+	return GetSignedInt(entry_index, FetchJmpFieldInfo(field_hash));
 }
 
-bool SBcsvIO::PokeU32(uint32_t offset, uint32_t value)
+int32_t SBcsvIO::GetSignedInt(uint32_t entry_index, SBcsvFieldHandle field)
 {
-	if (offset >= mEntryCount * mEntrySize)
-		return false;
+	// If field is nullptr, we failed to find a field matching the given name.
+	if (field == nullptr)
+		return 0;
 
-	mData[offset] = (uint8_t)(value >> 24);
-	mData[offset + 1] = (uint8_t)(value >> 16);
-	mData[offset + 2] = (uint8_t)(value >> 8);
-	mData[offset + 3] = (uint8_t)(value);
+	uint32_t value = GetUnsignedInt(entry_index, field);
 
-	return true;
+	switch (field->Type)
+	{
+	case EJmpFieldType::Short:
+		return (int16_t)value;
+	case EJmpFieldType::Byte:
+		return (int8_t)value;
+	default:
+		return (int32_t)value;
+	}
 }
 
-bool SBcsvIO::PokeS32(uint32_t offset, int32_t value)
+float SBcsvIO::GetFloat(uint32_t entry_index, std::string_view field_name)
 {
-	return PokeU32(offset, (uint32_t)value);
+	return GetFloat(entry_index, FetchJmpFieldInfo(field_name));
 }
 
-bool SBcsvIO::PokeF32(uint32_t offset, float value)
+float SBcsvIO::GetFloat(uint32_t entry_index, SBcsvFieldHandle field)
 {
+	// If field is nullptr, we failed to find a field matching the given name.
+	if (field == nullptr)
+		return 0.0f;
+
+	// Narrow fields can't hold a float, so return their integer value instead.
+	if (JmpFieldTypeSize(field->Type) != sizeof(float))
+		return (float)GetSignedInt(entry_index, field);
+
 	union {
 		uint32_t u32;
 		float f32;
 	} converter;
 
-	converter.f32 = value;
-	return PokeU32(offset, converter.u32);
+	converter.u32 = PeekField(entry_index, field);
+	return converter.f32;
 }
 
-uint32_t SBcsvIO::GetUnsignedInt(uint32_t entry_index, std::string field_name)
+bool SBcsvIO::GetBoolean(uint32_t entry_index, std::string_view field_name)
 {
-	const SBcsvFieldInfo* field = FetchJmpFieldInfo(field_name);
+	return GetUnsignedInt(entry_index, field_name) != 0;
+}
 
-	// If field is still nullptr, we failed to find a field matching the given name.
-	if (field == nullptr)
-		return 0;
+bool SBcsvIO::GetBoolean(uint32_t entry_index, SBcsvFieldHandle field)
+{
+	return GetUnsignedInt(entry_index, field) != 0;
+}
 
-	uint32_t fieldOffset = entry_index * mEntrySize + field->Start;
-	uint32_t rawFieldValue = PeekU32(fieldOffset);
+std::string SBcsvIO::GetString(uint32_t entry_index, std::string_view field_name)
+{
+	return GetString(entry_index, FetchJmpFieldInfo(field_name));
+}
 
-	return (rawFieldValue & field->Bitmask) >> field->Shift;
+std::string SBcsvIO::GetString(uint32_t entry_index, SBcsvFieldHandle field)
+{
+	return std::string(GetStringView(entry_index, field));
 }
 
-int32_t SBcsvIO::GetSignedInt(uint32_t entry_index, std::string field_name)
+std::string_view SBcsvIO::GetStringView(uint32_t entry_index, std::string_view field_name)
 {
-	const SBcsvFieldInfo* field = FetchJmpFieldInfo(field_name);
+	return GetStringView(entry_index, FetchJmpFieldInfo(field_name));
+}
 
-	// If field is still nullptr, we failed to find a field matching the given name.
+std::string_view SBcsvIO::GetStringView(uint32_t entry_index, SBcsvFieldHandle field)
+{
+	// If field is nullptr, we failed to find a field matching the given name.
 	if (field == nullptr)
-		return 0;
-
-	uint32_t fieldOffset = entry_index * mEntrySize + field->Start;
+		return "";
 
-	return PeekS32(fieldOffset);
+	return PeekString(PeekField(entry_index, field));
 }
 
-int32_t SBcsvIO::GetSignedInt(uint32_t entry_index, uint32_t field_hash)
+bool SBcsvIO::GatherColumn(SBcsvFieldHandle field, uint32_t* out) const
 {
-	const SBcsvFieldInfo* field = FetchJmpFieldInfo(field_hash);
-
-	// If field is still nullptr, we failed to find a field matching the given name.
 	if (field == nullptr)
-		return 0;
+		return false;
 
-	uint32_t fieldOffset = entry_index * mEntrySize + field->Start;
+	uint32_t width = JmpFieldTypeSize(field->Type);
+
+	// Bounds are checked once for the whole column instead of on every read.
+	if (field->Start + width > mEntrySize)
+		return false;
+
+	// Dispatch on the width once, so each loop below is branch-free.
+	const uint8_t* cell = mData + field->Start;
+	switch (width)
+	{
+	case sizeof(uint8_t):
+		for (int32_t entry = 0; entry < mEntryCount; entry++, cell += mEntrySize)
+			out[entry] = cell[0];
+		break;
+	case sizeof(uint16_t):
+		for (int32_t entry = 0; entry < mEntryCount; entry++, cell += mEntrySize)
+			out[entry] = cell[0] << 8 | cell[1];
+		break;
+	default:
+		for (int32_t entry = 0; entry < mEntryCount; entry++, cell += mEntrySize)
+			memcpy(&out[entry], cell, sizeof(uint32_t));
+
+		LGenUtility::SwapEndianArray32(out, mEntryCount);
+		break;
+	}
 
-	return PeekS32(fieldOffset);
+	return true;
 }
 
-float SBcsvIO::GetFloat(uint32_t entry_index, std::string field_name)
+bool SBcsvIO::GetUnsignedIntColumn(SBcsvFieldHandle field, uint32_t* out) const
 {
-	const SBcsvFieldInfo* field = FetchJmpFieldInfo(field_name);
-
-	// If field is still nullptr, we failed to find a field matching the given name.
-	if (field == nullptr)
-		return 0.0f;
+	if (!GatherColumn(field, out))
+		return false;
 
-	uint32_t fieldOffset = entry_index * mEntrySize + field->Start;
+	if (field->Bitmask != 0xFFFFFFFF || field->Shift != 0)
+	{
+		for (int32_t entry = 0; entry < mEntryCount; entry++)
+			out[entry] = (out[entry] & field->Bitmask) >> field->Shift;
+	}
 
-	return PeekF32(fieldOffset);
+	return true;
 }
 
-bool SBcsvIO::GetBoolean(uint32_t entry_index, std::string field_name)
+bool SBcsvIO::GetSignedIntColumn(SBcsvFieldHandle field, int32_t* out) const
 {
-	return GetUnsignedInt(entry_index, field_name) != 0;
+	if (!GetUnsignedIntColumn(field, (uint32_t*)out))
+		return false;
+
+	switch (field->Type)
+	{
+	case EJmpFieldType::Short:
+		for (int32_t entry = 0; entry < mEntryCount; entry++)
+			out[entry] = (int16_t)out[entry];
+		break;
+	case EJmpFieldType::Byte:
+		for (int32_t entry = 0; entry < mEntryCount; entry++)
+			out[entry] = (int8_t)out[entry];
+		break;
+	default:
+		break;
+	}
+
+	return true;
 }
 
-std::string SBcsvIO::GetString(uint32_t entry_index, std::string field_name)
+bool SBcsvIO::GetFloatColumn(SBcsvFieldHandle field, float* out) const
 {
-	const SBcsvFieldInfo* field = FetchJmpFieldInfo(field_name);
+	static_assert(sizeof(float) == sizeof(uint32_t), "float must be 32 bits!");
 
-	// If field is still nullptr, we failed to find a field matching the given name.
 	if (field == nullptr)
+		return false;
+
+	// Narrow fields decode as their integer value, same as GetFloat.
+	if (JmpFieldTypeSize(field->Type) != sizeof(float))
+	{
+		std::vector<int32_t> values(mEntryCount);
+		if (!GetSignedIntColumn(field, values.data()))
+			return false;
+
+		std::copy(values.begin(), values.end(), out);
+		return true;
+	}
+
+	// The swapped bits are reinterpreted in place, same as GetFloat does for a single value.
+	return GatherColumn(field, (uint32_t*)out);
+}
+
+std::string_view SBcsvIO::PeekString(uint32_t offset) const
+{
+	if (offset >= mStringTableSize)
 		return "";
 
-	uint32_t fieldOffset = entry_index * mEntrySize + field->Start;
-	uint32_t strOffset = PeekU32(fieldOffset);
+	const char* str = (const char*)mStringTable + offset;
+	const char* end = (const char*)memchr(str, '\0', mStringTableSize - offset);
+
+	return std::string_view(str, end != nullptr ? end - str : mStringTableSize - offset);
+}
+
+uint32_t SBcsvIO::AddString(std::string_view value)
+{
+	MakeWritable();
+
+	if (!mStringOffsetsBuilt)
+	{
+		for (uint32_t offset = 0; offset < mStringTableSize; )
+		{
+			std::string_view str = PeekString(offset);
+			mStringOffsets.try_emplace(std::string(str), offset);
+			offset += (uint32_t)str.size() + 1;
+		}
 
-	//char strBuffer[33];
-	//memcpy(strBuffer, mData + fieldOffset, mStringSize);
-	//strBuffer[32] = 0;
-	std::string strBuffer;
-	while(mStringTable[strOffset] != '\0'){
-		strBuffer.push_back(mStringTable[strOffset]);
-		strOffset++;
+		mStringOffsetsBuilt = true;
 	}
 
-	return strBuffer;
+	auto it = mStringOffsets.find(std::string(value));
+	if (it != mStringOffsets.end())
+		return it->second;
+
+	uint32_t offset = (uint32_t)mStringTableSize;
+	mStringTableStorage.insert(mStringTableStorage.end(), value.begin(), value.end());
+	mStringTableStorage.push_back('\0');
+
+	mStringTable = mStringTableStorage.data();
+	mStringTableSize = mStringTableStorage.size();
+
+	mStringOffsets.insert({std::string(value), offset});
+
+	return offset;
 }
 
 uint32_t SBcsvIO::CalculateNewEntrySize()
@@ -247,132 +433,253 @@ uint32_t SBcsvIO::CalculateNewEntrySize()
 	uint32_t newSize = 0;
 
 	for (const SBcsvFieldInfo f : mFields)
+		newSize = std::max(newSize, f.Start + JmpFieldTypeSize(f.Type));
+
+	return (uint32_t)LGenUtility::PadToBoundary(newSize, 4);
+}
+
+void SBcsvIO::CompactLayout()
+{
+	MakeWritable();
+
+	// Fields sharing a start offset are parts of the same bitfield and move as one.
+	std::map<uint16_t, uint32_t> slots;
+	for (const SBcsvFieldInfo& f : mFields)
+		slots[f.Start] = std::max(slots[f.Start], JmpFieldTypeSize(f.Type));
+
+	// Placing the widest slots first keeps every slot naturally aligned without padding.
+	std::vector<std::pair<uint16_t, uint32_t>> order(slots.begin(), slots.end());
+	std::stable_sort(order.begin(), order.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+
+	std::map<uint16_t, uint16_t> newStarts;
+	uint32_t newSize = 0;
+	for (const auto& [start, width] : order)
 	{
-		uint32_t tempNewSize = f.Start;
+		newStarts[start] = (uint16_t)newSize;
+		newSize += width;
+	}
 
-		if (f.Type == EJmpFieldType::String)
-			tempNewSize += mStringSize;
-		else
-			tempNewSize += sizeof(uint32_t);
+	uint32_t newEntrySize = (uint32_t)LGenUtility::PadToBoundary(newSize, 4);
+	std::vector<uint8_t> newData((size_t)mEntryCount * newEntrySize, 0);
 
-		newSize = std::max(newSize, tempNewSize);
+	for (int32_t entry = 0; entry < mEntryCount; entry++)
+	{
+		for (const auto& [start, width] : order)
+		{
+			if (start + width <= mEntrySize)
+				memcpy(newData.data() + entry * newEntrySize + newStarts[start], mData + entry * mEntrySize + start, width);
+		}
 	}
 
-	return newSize;
+	for (SBcsvFieldInfo& f : mFields)
+		f.Start = newStarts[f.Start];
+
+	mDataStorage = std::move(newData);
+	mData = mDataStorage.data();
+	mEntrySize = newEntrySize;
+	mLayoutChanged = true;
 }
 
-/*
-bool SBcsvIO::Save(std::vector<std::shared_ptr<LEntityDOMNode>> entities, bStream::CMemoryStream& stream)
+static void WriteU32BE(uint8_t* dest, uint32_t value)
 {
-	stream.writeInt32((int32_t)entities.size());
-	stream.writeInt32(mFieldCount);
-	stream.writeUInt32(mFieldCount * sizeof(SBcsvFieldInfo) + JMP_HEADER_SIZE);
+	dest[0] = (uint8_t)(value >> 24);
+	dest[1] = (uint8_t)(value >> 16);
+	dest[2] = (uint8_t)(value >> 8);
+	dest[3] = (uint8_t)(value);
+}
 
+bool SBcsvIO::Save(std::vector<uint8_t>& out)
+{
 	uint32_t newEntrySize = CalculateNewEntrySize();
-	stream.writeUInt32(newEntrySize);
+	uint32_t newEntryStartOffset = JMP_HEADER_SIZE + mFieldCount * JMP_FIELD_DEF_SIZE;
 
-	// Write the field info data
-	for (const SBcsvFieldInfo f : mFields)
+	std::vector<const SBcsvFieldInfo*> stringFields;
+	for (const SBcsvFieldInfo& f : mFields)
 	{
-		stream.writeUInt32(f.Hash);
-		stream.writeUInt32(f.Bitmask);
-		stream.writeUInt16(f.Start);
-		stream.writeUInt8(f.Shift);
-		stream.writeUInt8((uint8_t)f.Type);
+		if (f.Type == EJmpFieldType::String)
+			stringFields.push_back(&f);
 	}
 
-	// Discard old entry data
-	if (mData != nullptr)
-		delete[] mData;
+	// Build the deduplicated string table first so the output can be allocated in one go.
+	// The views point into the current string table, which is left alone until we're done.
+	std::unordered_map<std::string_view, uint32_t> stringOffsets;
+	std::vector<uint32_t> newStringOffsets(mEntryCount * stringFields.size());
+	size_t stringTableSize = 0;
 
-	uint32_t newDataSize = (entities.size() * newEntrySize + 31) & ~31;
+	for (int32_t entry = 0; entry < mEntryCount; entry++)
+	{
+		for (size_t i = 0; i < stringFields.size(); i++)
+		{
+			std::string_view str = PeekString(PeekField(entry, stringFields[i]));
 
-	// Allocate new entry data. Empty braces zero-initialize the memory region!
-	mData = new uint8_t[newDataSize] {};
-	if (mData == nullptr)
-		return false;
+			auto [it, inserted] = stringOffsets.try_emplace(str, (uint32_t)stringTableSize);
+			if (inserted)
+				stringTableSize += str.size() + 1;
 
-	for (uint32_t i = 0; i < entities.size(); i++)
+			newStringOffsets[entry * stringFields.size() + i] = it->second;
+		}
+	}
+
+	size_t entryDataEnd = newEntryStartOffset + (size_t)mEntryCount * newEntrySize;
+	size_t fileSize = LGenUtility::PadToBoundary(entryDataEnd + stringTableSize, 32);
+
+	out.assign(fileSize, 0);
+	uint8_t* dest = out.data();
+
+	WriteU32BE(dest, (uint32_t)mEntryCount);
+	WriteU32BE(dest + 4, (uint32_t)mFieldCount);
+	WriteU32BE(dest + 8, newEntryStartOffset);
+	WriteU32BE(dest + 12, newEntrySize);
+
+	uint8_t* fieldDest = dest + JMP_HEADER_SIZE;
+	for (const SBcsvFieldInfo& f : mFields)
 	{
-		entities[i]->Serialize(this, i);
+		WriteU32BE(fieldDest, f.Hash);
+		WriteU32BE(fieldDest + 4, f.Bitmask);
+		fieldDest[8] = (uint8_t)(f.Start >> 8);
+		fieldDest[9] = (uint8_t)(f.Start);
+		fieldDest[10] = f.Shift;
+		fieldDest[11] = (uint8_t)f.Type;
+		fieldDest += JMP_FIELD_DEF_SIZE;
+	}
+
+	// Copy each field into its slot in the new entry, then point the string fields at the new table.
+	for (int32_t entry = 0; entry < mEntryCount; entry++)
+	{
+		const uint8_t* srcEntry = mData + entry * mEntrySize;
+		uint8_t* destEntry = dest + newEntryStartOffset + entry * newEntrySize;
+
+		for (const SBcsvFieldInfo& f : mFields)
+		{
+			uint32_t width = JmpFieldTypeSize(f.Type);
+
+			if (f.Start + width <= mEntrySize)
+				memcpy(destEntry + f.Start, srcEntry + f.Start, width);
+		}
+
+		for (size_t i = 0; i < stringFields.size(); i++)
+			WriteU32BE(destEntry + stringFields[i]->Start, newStringOffsets[entry * stringFields.size() + i]);
 	}
 
-	stream.writeBytes((char*)mData, newDataSize);
+	for (const auto& [str, offset] : stringOffsets)
+		memcpy(dest + entryDataEnd + offset, str.data(), str.size());
+
+	// Files are padded out to 32 bytes with '@'.
+	std::fill(out.begin() + entryDataEnd + stringTableSize, out.end(), '@');
 
 	return true;
 }
-*/
 
-bool SBcsvIO::SetUnsignedInt(uint32_t entry_index, std::string field_name, uint32_t value)
+bool SBcsvIO::Save(bStream::CMemoryStream& stream)
 {
-	const SBcsvFieldInfo* field = FetchJmpFieldInfo(field_name);
-
-	// If field is still nullptr, we failed to find a field matching the given name.
-	if (field == nullptr)
+	std::vector<uint8_t> out;
+	if (!Save(out))
 		return false;
 
-	uint32_t fieldOffset = entry_index * mEntrySize + field->Start;
-
-	uint32_t curField = PeekU32(fieldOffset);
-	uint32_t packedValue = (value << field->Shift) & field->Bitmask;
+	stream.writeBytes((char*)out.data(), out.size());
 
-	return PokeU32(fieldOffset, (curField & ~field->Bitmask) | packedValue);
+	return true;
 }
 
-bool SBcsvIO::SetSignedInt(uint32_t entry_index, std::string field_name, int32_t value)
+bool SBcsvIO::Save(const std::vector<std::shared_ptr<ISerializable>>& entities, std::vector<uint8_t>& out)
 {
-	const SBcsvFieldInfo* field = FetchJmpFieldInfo(field_name);
+	// Keep the current string table around, entities may reference strings that are already in it.
+	MakeWritable();
 
-	// If field is still nullptr, we failed to find a field matching the given name.
-	if (field == nullptr)
-		return false;
+	mEntryCount = (int32_t)entities.size();
+	mEntrySize = CalculateNewEntrySize();
 
-	uint32_t fieldOffset = entry_index * mEntrySize + field->Start;
+	// Value-initialization zeroes the new entry data.
+	mDataStorage.assign(mEntryCount * mEntrySize, 0);
+	mData = mDataStorage.data();
 
-	return PokeS32(fieldOffset, value);
+	mDirtyRows.assign(mEntryCount, false);
+	mLayoutChanged = true;
+
+	for (uint32_t i = 0; i < entities.size(); i++)
+	{
+		entities[i]->Serialize(this, i);
+	}
+
+	return Save(out);
 }
 
-bool SBcsvIO::SetSignedInt(uint32_t entry_index, uint32_t field_hash, int32_t value)
+bool SBcsvIO::SetUnsignedInt(uint32_t entry_index, std::string_view field_name, uint32_t value)
 {
-	const SBcsvFieldInfo* field = FetchJmpFieldInfo(field_hash);
+	return SetUnsignedInt(entry_index, FetchJmpFieldInfo(field_name), value);
+}
 
-	// If field is still nullptr, we failed to find a field matching the given name.
+bool SBcsvIO::SetUnsignedInt(uint32_t entry_index, SBcsvFieldHandle field, uint32_t value)
+{
+	// If field is nullptr, we failed to find a field matching the given name.
 	if (field == nullptr)
 		return false;
 
-	uint32_t fieldOffset = entry_index * mEntrySize + field->Start;
+	uint32_t curField = PeekField(entry_index, field);
+	uint32_t packedValue = (value << field->Shift) & field->Bitmask;
+
+	return PokeField(entry_index, field, (curField & ~field->Bitmask) | packedValue);
+}
+
+bool SBcsvIO::SetSignedInt(uint32_t entry_index, std::string_view field_name, int32_t value)
+{
+	return SetSignedInt(entry_index, FetchJmpFieldInfo(field_name), value);
+}
+
+bool SBcsvIO::SetSignedInt(uint32_t entry_index, uint32_t field_hash, int32_t value)
+{
+	return SetSignedInt(entry_index, FetchJmpFieldInfo(field_hash), value);
+}
 
-	return PokeS32(fieldOffset, value);
+bool SBcsvIO::SetSignedInt(uint32_t entry_index, SBcsvFieldHandle field, int32_t value)
+{
+	// Packed the same way as unsigned values; narrow fields keep the low bits.
+	return SetUnsignedInt(entry_index, field, (uint32_t)value);
 }
 
-bool SBcsvIO::SetFloat(uint32_t entry_index, std::string field_name, float value)
+bool SBcsvIO::SetFloat(uint32_t entry_index, std::string_view field_name, float value)
 {
-	const SBcsvFieldInfo* field = FetchJmpFieldInfo(field_name);
+	return SetFloat(entry_index, FetchJmpFieldInfo(field_name), value);
+}
 
-	// If field is still nullptr, we failed to find a field matching the given name.
+bool SBcsvIO::SetFloat(uint32_t entry_index, SBcsvFieldHandle field, float value)
+{
+	// If field is nullptr, we failed to find a field matching the given name.
 	if (field == nullptr)
 		return false;
 
-	uint32_t fieldOffset = entry_index * mEntrySize + field->Start;
+	if (JmpFieldTypeSize(field->Type) != sizeof(float))
+		return SetSignedInt(entry_index, field, (int32_t)value);
 
-	return PokeF32(fieldOffset, value);
+	union {
+		uint32_t u32;
+		float f32;
+	} converter;
+
+	converter.f32 = value;
+	return PokeField(entry_index, field, converter.u32);
 }
 
-bool SBcsvIO::SetBoolean(uint32_t entry_index, std::string field_name, bool value)
+bool SBcsvIO::SetBoolean(uint32_t entry_index, std::string_view field_name, bool value)
 {
 	return SetUnsignedInt(entry_index, field_name, (uint32_t)value);
 }
 
-bool SBcsvIO::SetString(uint32_t entry_index, std::string field_name, std::string value)
+bool SBcsvIO::SetBoolean(uint32_t entry_index, SBcsvFieldHandle field, bool value)
 {
-	const SBcsvFieldInfo* field = FetchJmpFieldInfo(field_name);
+	return SetUnsignedInt(entry_index, field, (uint32_t)value);
+}
+
+bool SBcsvIO::SetString(uint32_t entry_index, std::string_view field_name, std::string value)
+{
+	return SetString(entry_index, FetchJmpFieldInfo(field_name), value);
+}
 
-	// If field is still nullptr, we failed to find a field matching the given name.
+bool SBcsvIO::SetString(uint32_t entry_index, SBcsvFieldHandle field, std::string value)
+{
+	// If field is nullptr, we failed to find a field matching the given name.
 	if (field == nullptr)
 		return false;
 
-	uint32_t fieldOffset = entry_index * mEntrySize + field->Start;
-	memcpy(mData + fieldOffset, value.data(), std::min(mStringSize - 1, value.length()));
-
-	return true;
+	return PokeField(entry_index, field, AddString(value));
 }
@@ -0,0 +1,259 @@
+#include "io/BcsvQuery.hpp"
+#include <bit>
+#include <cstdio>
+#include <unordered_map>
+
+SBcsvRowSet::SBcsvRowSet(uint32_t rowCount, bool set) : mRowCount(rowCount)
+{
+	mWords.assign((rowCount + 63) / 64, set ? ~0ull : 0ull);
+
+	// Keep the bits past the last row clear so Count and GetRows don't have to mask them.
+	if (set && rowCount % 64 != 0)
+		mWords.back() = (1ull << (rowCount % 64)) - 1;
+}
+
+uint32_t SBcsvRowSet::Count() const
+{
+	uint32_t count = 0;
+
+	for (uint64_t word : mWords)
+		count += std::popcount(word);
+
+	return count;
+}
+
+std::vector<uint32_t> SBcsvRowSet::GetRows() const
+{
+	std::vector<uint32_t> rows;
+	rows.reserve(Count());
+
+	for (size_t i = 0; i < mWords.size(); i++)
+	{
+		for (uint64_t word = mWords[i]; word != 0; word &= word - 1)
+			rows.push_back((uint32_t)(i * 64 + std::countr_zero(word)));
+	}
+
+	return rows;
+}
+
+SBcsvRowSet& SBcsvRowSet::operator&=(const SBcsvRowSet& other)
+{
+	for (size_t i = 0; i < mWords.size() && i < other.mWords.size(); i++)
+		mWords[i] &= other.mWords[i];
+
+	return *this;
+}
+
+SBcsvRowSet& SBcsvRowSet::operator|=(const SBcsvRowSet& other)
+{
+	for (size_t i = 0; i < mWords.size() && i < other.mWords.size(); i++)
+		mWords[i] |= other.mWords[i];
+
+	return *this;
+}
+
+// Evaluates the comparison for 64 rows at a time and ANDs the result into the row set.
+template<typename T, typename Compare>
+static void EvaluateBatches(const T* values, SBcsvRowSet& result, Compare compare)
+{
+	uint32_t rowCount = result.GetRowCount();
+	uint64_t* words = result.GetWords().data();
+
+	for (uint32_t base = 0; base < rowCount; base += 64)
+	{
+		uint32_t batchSize = std::min(64u, rowCount - base);
+		uint64_t mask = 0;
+
+		for (uint32_t i = 0; i < batchSize; i++)
+			mask |= (uint64_t)compare(values[base + i]) << i;
+
+		words[base / 64] &= mask;
+	}
+}
+
+template<typename T>
+static void EvaluateOp(EBcsvQueryOp op, const T operands[2], const T* values, SBcsvRowSet& result)
+{
+	const T a = operands[0], b = operands[1];
+
+	switch (op)
+	{
+	case EBcsvQueryOp::Equal:        EvaluateBatches(values, result, [a](T v) { return v == a; }); break;
+	case EBcsvQueryOp::NotEqual:     EvaluateBatches(values, result, [a](T v) { return v != a; }); break;
+	case EBcsvQueryOp::Less:         EvaluateBatches(values, result, [a](T v) { return v < a; }); break;
+	case EBcsvQueryOp::LessEqual:    EvaluateBatches(values, result, [a](T v) { return v <= a; }); break;
+	case EBcsvQueryOp::Greater:      EvaluateBatches(values, result, [a](T v) { return v > a; }); break;
+	case EBcsvQueryOp::GreaterEqual: EvaluateBatches(values, result, [a](T v) { return v >= a; }); break;
+	case EBcsvQueryOp::Between:      EvaluateBatches(values, result, [a, b](T v) { return (v >= a) & (v <= b); }); break;
+	}
+}
+
+SBcsvQuery::SPredicate& SBcsvQuery::AddPredicate(std::string_view field_name, EBcsvQueryOp op, EValueKind kind)
+{
+	SPredicate& predicate = mPredicates.emplace_back();
+	predicate.FieldHash = JmpHashFieldName(field_name);
+	predicate.Op = op;
+	predicate.Kind = kind;
+
+	return predicate;
+}
+
+SBcsvQuery& SBcsvQuery::Where(std::string_view field_name, EBcsvQueryOp op, int32_t value)
+{
+	SPredicate& predicate = AddPredicate(field_name, op, EValueKind::Int);
+	predicate.Int[0] = predicate.Int[1] = value;
+	predicate.Float[0] = predicate.Float[1] = (float)value;
+
+	return *this;
+}
+
+SBcsvQuery& SBcsvQuery::Where(std::string_view field_name, EBcsvQueryOp op, float value)
+{
+	SPredicate& predicate = AddPredicate(field_name, op, EValueKind::Float);
+	predicate.Float[0] = predicate.Float[1] = value;
+
+	return *this;
+}
+
+SBcsvQuery& SBcsvQuery::Where(std::string_view field_name, EBcsvQueryOp op, std::string_view value)
+{
+	SPredicate& predicate = AddPredicate(field_name, op, EValueKind::String);
+	predicate.String = value;
+
+	return *this;
+}
+
+SBcsvQuery& SBcsvQuery::WhereBetween(std::string_view field_name, int32_t min, int32_t max)
+{
+	SPredicate& predicate = AddPredicate(field_name, EBcsvQueryOp::Between, EValueKind::Int);
+	predicate.Int[0] = min;
+	predicate.Int[1] = max;
+	predicate.Float[0] = (float)min;
+	predicate.Float[1] = (float)max;
+
+	return *this;
+}
+
+SBcsvQuery& SBcsvQuery::WhereBetween(std::string_view field_name, float min, float max)
+{
+	SPredicate& predicate = AddPredicate(field_name, EBcsvQueryOp::Between, EValueKind::Float);
+	predicate.Float[0] = min;
+	predicate.Float[1] = max;
+
+	return *this;
+}
+
+SBcsvQuery& SBcsvQuery::Select(std::string_view field_name)
+{
+	mProjection.emplace_back(field_name);
+	return *this;
+}
+
+void SBcsvQuery::EvaluateInt(const SPredicate& predicate, const int32_t* values, SBcsvRowSet& result) const
+{
+	EvaluateOp(predicate.Op, predicate.Int, values, result);
+}
+
+void SBcsvQuery::EvaluateFloat(const SPredicate& predicate, const float* values, SBcsvRowSet& result) const
+{
+	EvaluateOp(predicate.Op, predicate.Float, values, result);
+}
+
+void SBcsvQuery::EvaluateString(const SPredicate& predicate, SBcsvIO& bcsv, SBcsvFieldHandle field, SBcsvRowSet& result) const
+{
+	if (predicate.Op != EBcsvQueryOp::Equal && predicate.Op != EBcsvQueryOp::NotEqual)
+	{
+		result = SBcsvRowSet(result.GetRowCount(), false);
+		return;
+	}
+
+	std::vector<uint32_t> offsets(result.GetRowCount());
+	bcsv.GetUnsignedIntColumn(field, offsets.data());
+
+	// Rows mostly share a handful of strings, so only compare each distinct offset once.
+	std::unordered_map<uint32_t, bool> matches;
+	std::vector<uint8_t> rowMatches(result.GetRowCount());
+
+	for (uint32_t row = 0; row < result.GetRowCount(); row++)
+	{
+		auto it = matches.find(offsets[row]);
+		if (it == matches.end())
+			it = matches.insert({offsets[row], bcsv.GetStringView(row, field) == predicate.String}).first;
+
+		rowMatches[row] = it->second;
+	}
+
+	bool wanted = predicate.Op == EBcsvQueryOp::Equal;
+	EvaluateBatches(rowMatches.data(), result, [wanted](uint8_t match) { return (match != 0) == wanted; });
+}
+
+SBcsvRowSet SBcsvQuery::Execute(SBcsvIO& bcsv) const
+{
+	uint32_t rowCount = (uint32_t)std::max(bcsv.GetEntryCount(), 0);
+	SBcsvRowSet result(rowCount, true);
+
+	std::vector<int32_t> intColumn;
+	std::vector<float> floatColumn;
+
+	for (const SPredicate& predicate : mPredicates)
+	{
+		SBcsvFieldHandle field = bcsv.GetFieldHandle(predicate.FieldHash);
+
+		if (field == nullptr)
+			return SBcsvRowSet(rowCount, false);
+
+		if (field->Type == EJmpFieldType::String || predicate.Kind == EValueKind::String)
+		{
+			if (field->Type != EJmpFieldType::String || predicate.Kind != EValueKind::String)
+				return SBcsvRowSet(rowCount, false);
+
+			EvaluateString(predicate, bcsv, field, result);
+		}
+		else if (field->Type == EJmpFieldType::Float)
+		{
+			floatColumn.resize(rowCount);
+			bcsv.GetFloatColumn(field, floatColumn.data());
+			EvaluateFloat(predicate, floatColumn.data(), result);
+		}
+		else
+		{
+			// Bitfields are compared by their unpacked value, narrow fields after sign extension.
+			intColumn.resize(rowCount);
+			bcsv.GetSignedIntColumn(field, intColumn.data());
+
+			if (predicate.Kind == EValueKind::Float)
+			{
+				floatColumn.assign(intColumn.begin(), intColumn.end());
+				EvaluateFloat(predicate, floatColumn.data(), result);
+			}
+			else
+			{
+				EvaluateInt(predicate, intColumn.data(), result);
+			}
+		}
+	}
+
+	return result;
+}
+
+std::string SBcsvQuery::FormatField(SBcsvIO& bcsv, uint32_t entry_index, std::string_view field_name)
+{
+	SBcsvFieldHandle field = bcsv.GetFieldHandle(field_name);
+
+	if (field == nullptr)
+		return "(null)";
+
+	switch (field->Type)
+	{
+	case EJmpFieldType::String:
+		return std::string(bcsv.GetStringView(entry_index, field));
+	case EJmpFieldType::Float:
+	{
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), "%g", bcsv.GetFloat(entry_index, field));
+		return buffer;
+	}
+	default:
+		return std::to_string(bcsv.GetSignedInt(entry_index, field));
+	}
+}
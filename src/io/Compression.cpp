@@ -0,0 +1,568 @@
+#include "io/Compression.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+namespace {
+	constexpr size_t WINDOW_SIZE = 0x1000;
+	constexpr size_t MIN_MATCH = 3;
+	constexpr size_t MAX_MATCH = 0x111;
+	constexpr size_t HASH_BITS = 15;
+
+	// Inputs are split into chunks of this size for match finding. Matches may reach back
+	// into the previous chunk but never run past the end of their own.
+	constexpr size_t CHUNK_SIZE = 0x40000;
+
+	struct SCompressionToken
+	{
+		// 0 for a literal, otherwise the length of a back-reference.
+		uint16_t Length;
+		uint16_t Distance;
+	};
+
+	struct SLevelParams
+	{
+		uint32_t MaxChain;
+		// Stop searching once a match this long is found.
+		size_t NiceLength;
+		bool Lazy;
+	};
+
+	SLevelParams GetLevelParams(ECompressionLevel level)
+	{
+		switch (level)
+		{
+			case ECompressionLevel::Fast: return { 4, 32, false };
+			case ECompressionLevel::Max: return { WINDOW_SIZE, MAX_MATCH, true };
+			default: return { 64, 128, true };
+		}
+	}
+
+	uint32_t ReadU32BE(const uint8_t* src)
+	{
+		return src[0] << 24 | src[1] << 16 | src[2] << 8 | src[3];
+	}
+
+	void WriteU32BE(std::vector<uint8_t>& dst, uint32_t value)
+	{
+		dst.push_back(value >> 24);
+		dst.push_back(value >> 16);
+		dst.push_back(value >> 8);
+		dst.push_back(value);
+	}
+
+	// How much input a decoder gets through between calls to its release callback.
+	constexpr size_t RELEASE_STEP = 0x100000;
+
+	// Hands the input between released and pos to release_input once there's a step's worth of it.
+	inline void ReleaseInput(const SCompression::SReleaseInputFn& release_input, size_t& released, size_t pos)
+	{
+		if (release_input && pos - released >= RELEASE_STEP)
+		{
+			release_input(released, pos - released);
+			released = pos;
+		}
+	}
+
+	// Hash chains over one chunk plus the window before it.
+	class SMatchFinder
+	{
+		const uint8_t* mSrc;
+		size_t mSrcSize;
+		size_t mBase;
+		std::vector<int32_t> mHead;
+		std::vector<int32_t> mPrev;
+		SLevelParams mParams;
+
+		uint32_t Hash(size_t pos) const
+		{
+			uint32_t v = mSrc[pos] << 16 | mSrc[pos + 1] << 8 | mSrc[pos + 2];
+			return (v * 2654435761u) >> (32 - HASH_BITS);
+		}
+
+	public:
+		SMatchFinder(const uint8_t* src, size_t src_size, size_t base, size_t end, SLevelParams params)
+			: mSrc(src), mSrcSize(src_size), mBase(base), mHead(1 << HASH_BITS, -1), mPrev(end - base, -1), mParams(params) {}
+
+		void Insert(size_t pos)
+		{
+			if (pos + MIN_MATCH > mSrcSize)
+				return;
+
+			uint32_t h = Hash(pos);
+			mPrev[pos - mBase] = mHead[h];
+			mHead[h] = (int32_t)pos;
+		}
+
+		// Longest match for pos that ends at or before limit.
+		SCompressionToken Find(size_t pos, size_t limit) const
+		{
+			SCompressionToken best { 0, 0 };
+			size_t maxLength = std::min(MAX_MATCH, limit - pos);
+			if (maxLength < MIN_MATCH)
+				return best;
+
+			size_t bestLength = MIN_MATCH - 1;
+			uint32_t chain = mParams.MaxChain;
+
+			for (int32_t candidate = mHead[Hash(pos)]; candidate >= 0 && chain > 0; chain--)
+			{
+				size_t dist = pos - candidate;
+				if (dist > WINDOW_SIZE)
+					break;
+
+				const uint8_t* a = mSrc + candidate;
+				const uint8_t* b = mSrc + pos;
+
+				// Only a longer match is interesting, so check the byte that would make it longer first.
+				if (a[bestLength] == b[bestLength])
+				{
+					size_t length = 0;
+					while (length < maxLength && a[length] == b[length])
+						length++;
+
+					if (length > bestLength)
+					{
+						bestLength = length;
+						best = { (uint16_t)length, (uint16_t)dist };
+
+						if (length >= mParams.NiceLength || length == maxLength)
+							break;
+					}
+				}
+
+				candidate = mPrev[candidate - mBase];
+			}
+
+			return best;
+		}
+	};
+
+	void FindChunkTokens(const uint8_t* src, size_t src_size, size_t start, size_t end, SLevelParams params, std::vector<SCompressionToken>& tokens)
+	{
+		size_t base = start > WINDOW_SIZE ? start - WINDOW_SIZE : 0;
+		SMatchFinder finder(src, src_size, base, end, params);
+
+		for (size_t pos = base; pos < start; pos++)
+			finder.Insert(pos);
+
+		tokens.reserve((end - start) / 2);
+
+		size_t pos = start;
+		while (pos < end)
+		{
+			SCompressionToken match = finder.Find(pos, end);
+
+			// Lazy matching: if the next byte starts a longer match, emit a literal instead.
+			if (params.Lazy && match.Length != 0 && match.Length < params.NiceLength && pos + 1 < end)
+			{
+				finder.Insert(pos);
+				SCompressionToken next = finder.Find(pos + 1, end);
+				if (next.Length > match.Length)
+				{
+					tokens.push_back({ 0, 0 });
+					pos++;
+					continue;
+				}
+
+				for (size_t i = 1; i < match.Length; i++)
+					finder.Insert(pos + i);
+
+				tokens.push_back(match);
+				pos += match.Length;
+				continue;
+			}
+
+			if (match.Length == 0)
+			{
+				finder.Insert(pos);
+				tokens.push_back({ 0, 0 });
+				pos++;
+				continue;
+			}
+
+			for (size_t i = 0; i < match.Length; i++)
+				finder.Insert(pos + i);
+
+			tokens.push_back(match);
+			pos += match.Length;
+		}
+	}
+
+	// Runs the match finder over every chunk, spreading the chunks across threads.
+	std::vector<std::vector<SCompressionToken>> FindTokens(const uint8_t* src, size_t src_size, ECompressionLevel level)
+	{
+		SLevelParams params = GetLevelParams(level);
+		size_t chunkCount = (src_size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+		std::vector<std::vector<SCompressionToken>> chunkTokens(chunkCount);
+
+		auto processChunk = [&](size_t chunk) {
+			size_t start = chunk * CHUNK_SIZE;
+			size_t end = std::min(start + CHUNK_SIZE, src_size);
+			FindChunkTokens(src, src_size, start, end, params, chunkTokens[chunk]);
+		};
+
+		size_t threadCount = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), chunkCount);
+		if (threadCount <= 1)
+		{
+			for (size_t chunk = 0; chunk < chunkCount; chunk++)
+				processChunk(chunk);
+
+			return chunkTokens;
+		}
+
+		std::atomic<size_t> nextChunk { 0 };
+		std::vector<std::thread> workers;
+		workers.reserve(threadCount);
+
+		for (size_t i = 0; i < threadCount; i++)
+		{
+			workers.emplace_back([&]() {
+				for (size_t chunk = nextChunk++; chunk < chunkCount; chunk = nextChunk++)
+					processChunk(chunk);
+			});
+		}
+
+		for (std::thread& worker : workers)
+			worker.join();
+
+		return chunkTokens;
+	}
+
+	// Appends the two or three byte encoding of a back-reference shared by Yaz0 and Yay0.
+	// Yay0 keeps the extended length byte in its literal stream, so it's written to ext.
+	void WriteBackReference(std::vector<uint8_t>& dst, std::vector<uint8_t>& ext, const SCompressionToken& token)
+	{
+		uint32_t dist = token.Distance - 1;
+
+		if (token.Length >= 0x12)
+		{
+			dst.push_back(dist >> 8);
+			dst.push_back(dist & 0xFF);
+			ext.push_back(token.Length - 0x12);
+		}
+		else
+		{
+			dst.push_back(((token.Length - 2) << 4) | (dist >> 8));
+			dst.push_back(dist & 0xFF);
+		}
+	}
+
+	// Slack callers must leave after a match for CopyMatch's wide copies to be used.
+	constexpr size_t MATCH_SLACK = 16;
+
+	// Copies a back-reference of the given length from dist bytes behind dst. With has_slack set,
+	// the copy may write up to MATCH_SLACK bytes past the match; the next token overwrites them.
+	inline void CopyMatch(uint8_t* dst, size_t dist, size_t length, bool has_slack)
+	{
+		if (dist == 1)
+		{
+			// Runs of a single byte are common in padding and model data.
+			memset(dst, dst[-1], length);
+			return;
+		}
+
+		if (!has_slack)
+		{
+			for (size_t i = 0; i < length; i++)
+				dst[i] = dst[i - dist];
+			return;
+		}
+
+		// Short patterns overlap their own copy. Copying the pattern once doubles it, and the
+		// doubled pattern repeats at twice the distance, until it's wide enough for 16 byte steps.
+		size_t pos = 0;
+		for (; dist < 16 && pos < length; dist *= 2)
+		{
+			memcpy(dst + pos, dst + pos - dist, dist);
+			pos += dist;
+		}
+
+		for (; pos < length; pos += 16)
+			memcpy(dst + pos, dst + pos - dist, 16);
+	}
+}
+
+size_t SCompression::GetDecompressedSize(const uint8_t* src, size_t src_size)
+{
+	if (src_size < YAZ0_HEADER_SIZE)
+		return 0;
+
+	uint32_t magic = ReadU32BE(src);
+	if (magic != YAZ0_MAGIC && magic != YAY0_MAGIC)
+		return 0;
+
+	return ReadU32BE(src + 4);
+}
+
+bool SCompression::Yaz0Decompress(const uint8_t* src, size_t src_size, uint8_t* dst, size_t dst_size, const SReleaseInputFn& release_input)
+{
+	if (src_size < YAZ0_HEADER_SIZE || ReadU32BE(src) != YAZ0_MAGIC)
+		return false;
+
+	size_t outSize = ReadU32BE(src + 4);
+	if (outSize > dst_size)
+		return false;
+
+	const uint8_t* ip = src + YAZ0_HEADER_SIZE;
+	const uint8_t* iend = src + src_size;
+	uint8_t* op = dst;
+	uint8_t* oend = dst + outSize;
+	size_t released = 0;
+
+	while (op < oend)
+	{
+		if (ip >= iend)
+			return false;
+
+		ReleaseInput(release_input, released, ip - src);
+
+		uint8_t flags = *ip++;
+
+		// A group of eight literals is a straight copy.
+		if (flags == 0xFF && iend - ip >= 8 && oend - op >= 8)
+		{
+			memcpy(op, ip, 8);
+			ip += 8;
+			op += 8;
+			continue;
+		}
+
+		for (int bit = 7; bit >= 0 && op < oend; bit--)
+		{
+			if (flags & (1 << bit))
+			{
+				if (ip >= iend)
+					return false;
+
+				*op++ = *ip++;
+				continue;
+			}
+
+			if (iend - ip < 2)
+				return false;
+
+			size_t dist = (((ip[0] & 0x0F) << 8) | ip[1]) + 1;
+			size_t length = ip[0] >> 4;
+			ip += 2;
+
+			if (length == 0)
+			{
+				if (ip >= iend)
+					return false;
+
+				length = *ip++ + 0x12;
+			}
+			else
+			{
+				length += 2;
+			}
+
+			if (dist > (size_t)(op - dst) || length > (size_t)(oend - op))
+				return false;
+
+			CopyMatch(op, dist, length, (size_t)(oend - op) >= length + MATCH_SLACK);
+			op += length;
+		}
+	}
+
+	return true;
+}
+
+bool SCompression::Yay0Decompress(const uint8_t* src, size_t src_size, uint8_t* dst, size_t dst_size, const SReleaseInputFn& release_input)
+{
+	if (src_size < YAY0_HEADER_SIZE || ReadU32BE(src) != YAY0_MAGIC)
+		return false;
+
+	size_t outSize = ReadU32BE(src + 4);
+	size_t linkOffset = ReadU32BE(src + 8);
+	size_t chunkOffset = ReadU32BE(src + 12);
+
+	if (outSize > dst_size || linkOffset > src_size || chunkOffset > src_size)
+		return false;
+
+	// Yay0 splits the stream in three: flag words, back-references and literal bytes.
+	const uint8_t* flagPtr = src + YAY0_HEADER_SIZE;
+	const uint8_t* flagEnd = src + linkOffset;
+	const uint8_t* linkPtr = src + linkOffset;
+	const uint8_t* linkEnd = src + src_size;
+	const uint8_t* chunkPtr = src + chunkOffset;
+	const uint8_t* chunkEnd = src + src_size;
+
+	uint8_t* op = dst;
+	uint8_t* oend = dst + outSize;
+
+	// The three streams are read at different rates, so each is released on its own.
+	size_t flagsReleased = YAY0_HEADER_SIZE;
+	size_t linksReleased = linkOffset;
+	size_t chunksReleased = chunkOffset;
+
+	while (op < oend)
+	{
+		if (flagEnd - flagPtr < 4)
+			return false;
+
+		ReleaseInput(release_input, flagsReleased, flagPtr - src);
+		ReleaseInput(release_input, linksReleased, linkPtr - src);
+		ReleaseInput(release_input, chunksReleased, chunkPtr - src);
+
+		uint32_t flags = ReadU32BE(flagPtr);
+		flagPtr += 4;
+
+		// 32 literals in a row are a straight copy from the chunk stream.
+		if (flags == 0xFFFFFFFF && chunkEnd - chunkPtr >= 32 && oend - op >= 32)
+		{
+			memcpy(op, chunkPtr, 32);
+			chunkPtr += 32;
+			op += 32;
+			continue;
+		}
+
+		for (int bit = 31; bit >= 0 && op < oend; bit--)
+		{
+			if (flags & (1u << bit))
+			{
+				if (chunkPtr >= chunkEnd)
+					return false;
+
+				*op++ = *chunkPtr++;
+				continue;
+			}
+
+			if (linkEnd - linkPtr < 2)
+				return false;
+
+			size_t dist = (((linkPtr[0] & 0x0F) << 8) | linkPtr[1]) + 1;
+			size_t length = linkPtr[0] >> 4;
+			linkPtr += 2;
+
+			if (length == 0)
+			{
+				if (chunkPtr >= chunkEnd)
+					return false;
+
+				length = *chunkPtr++ + 0x12;
+			}
+			else
+			{
+				length += 2;
+			}
+
+			if (dist > (size_t)(op - dst) || length > (size_t)(oend - op))
+				return false;
+
+			CopyMatch(op, dist, length, (size_t)(oend - op) >= length + MATCH_SLACK);
+			op += length;
+		}
+	}
+
+	return true;
+}
+
+void SCompression::Yaz0Compress(const uint8_t* src, size_t src_size, std::vector<uint8_t>& dst, ECompressionLevel level)
+{
+	std::vector<std::vector<SCompressionToken>> chunkTokens = FindTokens(src, src_size, level);
+
+	dst.clear();
+	dst.reserve(YAZ0_HEADER_SIZE + src_size + src_size / 8 + 1);
+
+	WriteU32BE(dst, YAZ0_MAGIC);
+	WriteU32BE(dst, (uint32_t)src_size);
+	WriteU32BE(dst, 0);
+	WriteU32BE(dst, 0);
+
+	size_t pos = 0;
+	size_t flagOffset = 0;
+	int bit = -1;
+
+	for (const std::vector<SCompressionToken>& tokens : chunkTokens)
+	{
+		for (const SCompressionToken& token : tokens)
+		{
+			if (bit < 0)
+			{
+				flagOffset = dst.size();
+				dst.push_back(0);
+				bit = 7;
+			}
+
+			if (token.Length == 0)
+			{
+				dst[flagOffset] |= 1 << bit;
+				dst.push_back(src[pos++]);
+			}
+			else
+			{
+				// Yaz0 keeps the extended length inline, right after the reference.
+				WriteBackReference(dst, dst, token);
+				pos += token.Length;
+			}
+
+			bit--;
+		}
+	}
+}
+
+void SCompression::Yay0Compress(const uint8_t* src, size_t src_size, std::vector<uint8_t>& dst, ECompressionLevel level)
+{
+	std::vector<std::vector<SCompressionToken>> chunkTokens = FindTokens(src, src_size, level);
+
+	std::vector<uint32_t> flags;
+	std::vector<uint8_t> links;
+	std::vector<uint8_t> chunks;
+	chunks.reserve(src_size);
+
+	size_t pos = 0;
+	int bit = -1;
+
+	for (const std::vector<SCompressionToken>& tokens : chunkTokens)
+	{
+		for (const SCompressionToken& token : tokens)
+		{
+			if (bit < 0)
+			{
+				flags.push_back(0);
+				bit = 31;
+			}
+
+			if (token.Length == 0)
+			{
+				flags.back() |= 1u << bit;
+				chunks.push_back(src[pos++]);
+			}
+			else
+			{
+				WriteBackReference(links, chunks, token);
+				pos += token.Length;
+			}
+
+			bit--;
+		}
+	}
+
+	size_t linkOffset = YAY0_HEADER_SIZE + flags.size() * sizeof(uint32_t);
+	size_t chunkOffset = linkOffset + links.size();
+
+	dst.clear();
+	dst.reserve(chunkOffset + chunks.size());
+
+	WriteU32BE(dst, YAY0_MAGIC);
+	WriteU32BE(dst, (uint32_t)src_size);
+	WriteU32BE(dst, (uint32_t)linkOffset);
+	WriteU32BE(dst, (uint32_t)chunkOffset);
+
+	for (uint32_t word : flags)
+		WriteU32BE(dst, word);
+
+	dst.insert(dst.end(), links.begin(), links.end());
+	dst.insert(dst.end(), chunks.begin(), chunks.end());
+}
+
+void SCompression::Compress(ECompressionFormat format, const uint8_t* src, size_t src_size, std::vector<uint8_t>& dst, ECompressionLevel level)
+{
+	if (format == ECompressionFormat::Yaz0)
+		Yaz0Compress(src, src_size, dst, level);
+	else
+		Yay0Compress(src, src_size, dst, level);
+}
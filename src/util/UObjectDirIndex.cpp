@@ -0,0 +1,129 @@
+#include "UObjectDirIndex.hpp"
+#include <iostream>
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <climits>
+#endif
+
+static bool IsArchiveName(const std::filesystem::path& name) {
+	return name.extension() == ".arc";
+}
+
+void UObjectDirIndex::SetDirectory(const std::filesystem::path& directory) {
+	if (directory == mDirectory)
+		return;
+
+	mDirectory = directory;
+	mNeedsScan = true;
+}
+
+void UObjectDirIndex::CloseWatch() {
+#if defined(__linux__)
+	if (mNotifyFd >= 0)
+		close(mNotifyFd);
+#endif
+	mNotifyFd = -1;
+	mWatch = -1;
+}
+
+void UObjectDirIndex::Scan() {
+	CloseWatch();
+	mNeedsScan = false;
+	mArchives.clear();
+	mMissing.clear();
+
+	if (mDirectory.empty())
+		return;
+
+#if defined(__linux__)
+	// Set up before the scan so nothing added while it runs is missed.
+	mNotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (mNotifyFd >= 0) {
+		// Archives are only added once they've been written out in full, IN_CREATE would let one
+		// be opened while it's still being copied in.
+		mWatch = inotify_add_watch(mNotifyFd, mDirectory.c_str(), IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF);
+		if (mWatch < 0)
+			CloseWatch();
+	}
+#endif
+
+	std::error_code error;
+	for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(mDirectory, error)) {
+		if (IsArchiveName(entry.path()))
+			mArchives.insert(entry.path().stem().string());
+	}
+
+	if (error)
+		std::cout << "Couldn't read object directory " << mDirectory << ": " << error.message() << std::endl;
+}
+
+void UObjectDirIndex::Refresh() {
+#if defined(__linux__)
+	if (mNeedsScan || mNotifyFd < 0) {
+		Scan();
+		return;
+	}
+
+	DrainEvents();
+#else
+	Scan();
+#endif
+}
+
+void UObjectDirIndex::DrainEvents() {
+#if defined(__linux__)
+	if (mNotifyFd < 0)
+		return;
+
+	alignas(inotify_event) char buffer[16 * (sizeof(inotify_event) + NAME_MAX + 1)];
+	bool rescan = false;
+
+	while (true) {
+		ssize_t length = read(mNotifyFd, buffer, sizeof(buffer));
+		if (length <= 0)
+			break;
+
+		for (ssize_t offset = 0; offset < length;) {
+			const inotify_event* event = (const inotify_event*)(buffer + offset);
+			offset += sizeof(inotify_event) + event->len;
+
+			// Events were dropped, or the directory itself went away.
+			if (event->mask & (IN_Q_OVERFLOW | IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+				rescan = true;
+				continue;
+			}
+
+			if (event->len == 0 || !IsArchiveName(event->name))
+				continue;
+
+			std::string name = std::filesystem::path(event->name).stem().string();
+			if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+				mArchives.insert(name);
+				mMissing.erase(name);
+			} else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+				mArchives.erase(name);
+			}
+		}
+	}
+
+	if (rescan)
+		Scan();
+#endif
+}
+
+bool UObjectDirIndex::Contains(std::string_view name) {
+	// Cheap when nothing's changed, the read returns straight away.
+	if (!mNeedsScan)
+		DrainEvents();
+
+	std::string key(name);
+	if (mArchives.contains(key))
+		return true;
+
+	if (mMissing.insert(key).second)
+		std::cout << "Couldn't find model " << key << std::endl;
+
+	return false;
+}
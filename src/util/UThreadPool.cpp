@@ -0,0 +1,42 @@
+#include "UThreadPool.hpp"
+#include <algorithm>
+
+UThreadPool::UThreadPool(size_t threadCount) {
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	mWorkers.reserve(threadCount);
+	for (size_t i = 0; i < threadCount; i++)
+		mWorkers.emplace_back(&UThreadPool::WorkerLoop, this);
+}
+
+UThreadPool::~UThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStopping = true;
+	}
+
+	mCondition.notify_all();
+
+	for (std::thread& worker : mWorkers)
+		worker.join();
+}
+
+void UThreadPool::WorkerLoop() {
+	while (true) {
+		std::function<void()> task;
+
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mCondition.wait(lock, [this]() { return mStopping || !mTasks.empty(); });
+
+			if (mTasks.empty())
+				return;
+
+			task = std::move(mTasks.front());
+			mTasks.pop_front();
+		}
+
+		task();
+	}
+}
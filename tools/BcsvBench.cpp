@@ -0,0 +1,147 @@
+// Benchmarks decoding placement columns cell by cell against the columnar accessors.
+//
+// Usage: bcsvbench [rows] [iterations]
+//
+// Builds a synthetic objinfo-like table (100000 rows by default) in memory and decodes every
+// transform column three ways: by field name per cell, the way placement was read before
+// columns existed, by field handle per cell, and by column. Speedups are relative to the
+// name lookups. Fails if any two disagree on a value.
+
+#include "io/BcsvIO.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static const char* ColumnNames[] = { "pos_x", "pos_y", "pos_z", "dir_x", "dir_y", "dir_z", "scale_x", "scale_y", "scale_z" };
+static constexpr uint32_t ColumnCount = sizeof(ColumnNames) / sizeof(ColumnNames[0]);
+
+static void WriteU32(std::vector<uint8_t>& out, size_t offset, uint32_t value)
+{
+	out[offset + 0] = (uint8_t)(value >> 24);
+	out[offset + 1] = (uint8_t)(value >> 16);
+	out[offset + 2] = (uint8_t)(value >> 8);
+	out[offset + 3] = (uint8_t)value;
+}
+
+// One string field followed by the float columns, laid out like a real objinfo file.
+static std::vector<uint8_t> BuildTable(uint32_t rowCount)
+{
+	const uint32_t fieldCount = ColumnCount + 1;
+	const uint32_t entrySize = fieldCount * 4;
+	const uint32_t entryStart = (uint32_t)(JMP_HEADER_SIZE + fieldCount * JMP_FIELD_DEF_SIZE);
+	const char stringTable[] = "Kuribo\0Coin\0";
+
+	std::vector<uint8_t> data(entryStart + (size_t)rowCount * entrySize + sizeof(stringTable), 0);
+
+	WriteU32(data, 0, rowCount);
+	WriteU32(data, 4, fieldCount);
+	WriteU32(data, 8, entryStart);
+	WriteU32(data, 12, entrySize);
+
+	for (uint32_t field = 0; field < fieldCount; field++)
+	{
+		size_t def = JMP_HEADER_SIZE + field * JMP_FIELD_DEF_SIZE;
+		WriteU32(data, def, JmpHashFieldName(field == 0 ? "name" : ColumnNames[field - 1]));
+		WriteU32(data, def + 4, 0xFFFFFFFF);
+		data[def + 8] = (uint8_t)((field * 4) >> 8);
+		data[def + 9] = (uint8_t)(field * 4);
+		data[def + 10] = 0;
+		data[def + 11] = (uint8_t)(field == 0 ? EJmpFieldType::String : EJmpFieldType::Float);
+	}
+
+	for (uint32_t row = 0; row < rowCount; row++)
+	{
+		size_t entry = entryStart + (size_t)row * entrySize;
+		WriteU32(data, entry, (row & 1) ? 7 : 0);
+
+		for (uint32_t column = 0; column < ColumnCount; column++)
+		{
+			float value = (float)(row * 0.5 - column * 100.0);
+			uint32_t bits;
+			memcpy(&bits, &value, sizeof(bits));
+			WriteU32(data, entry + 4 + column * 4, bits);
+		}
+	}
+
+	memcpy(data.data() + entryStart + (size_t)rowCount * entrySize, stringTable, sizeof(stringTable));
+	return data;
+}
+
+int main(int argc, char* argv[])
+{
+	uint32_t rowCount = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 0) : 100000;
+	uint32_t iterations = argc > 2 ? (uint32_t)strtoul(argv[2], nullptr, 0) : 20;
+	if (rowCount == 0 || iterations == 0)
+	{
+		std::cout << "Usage: bcsvbench [rows] [iterations]" << std::endl;
+		return 1;
+	}
+
+	std::vector<uint8_t> data = BuildTable(rowCount);
+
+	SBcsvIO bcsv;
+	bStream::CMemoryStream stream(data.data(), data.size(), bStream::Endianess::Big, bStream::OpenMode::In);
+	if (!bcsv.LoadView(&stream))
+	{
+		std::cout << "Error loading the synthetic table" << std::endl;
+		return 1;
+	}
+
+	SBcsvFieldHandle handles[ColumnCount];
+	for (uint32_t column = 0; column < ColumnCount; column++)
+		handles[column] = bcsv.GetFieldHandle(ColumnNames[column]);
+
+	std::vector<float> named((size_t)rowCount * ColumnCount);
+	std::vector<float> cells((size_t)rowCount * ColumnCount);
+	std::vector<float> columns((size_t)rowCount * ColumnCount);
+
+	using Clock = std::chrono::steady_clock;
+	Clock::duration namedTime {}, cellTime {}, columnTime {};
+
+	for (uint32_t iteration = 0; iteration < iterations; iteration++)
+	{
+		Clock::time_point start = Clock::now();
+		for (uint32_t row = 0; row < rowCount; row++)
+		{
+			for (uint32_t column = 0; column < ColumnCount; column++)
+				named[(size_t)column * rowCount + row] = bcsv.GetFloat(row, ColumnNames[column]);
+		}
+		namedTime += Clock::now() - start;
+
+		start = Clock::now();
+		for (uint32_t column = 0; column < ColumnCount; column++)
+		{
+			float* out = cells.data() + (size_t)column * rowCount;
+			for (uint32_t row = 0; row < rowCount; row++)
+				out[row] = bcsv.GetFloat(row, handles[column]);
+		}
+		cellTime += Clock::now() - start;
+
+		start = Clock::now();
+		for (uint32_t column = 0; column < ColumnCount; column++)
+			bcsv.GetFloatColumn(handles[column], columns.data() + (size_t)column * rowCount);
+		columnTime += Clock::now() - start;
+	}
+
+	if (memcmp(named.data(), cells.data(), named.size() * sizeof(float)) != 0 ||
+	    memcmp(cells.data(), columns.data(), cells.size() * sizeof(float)) != 0)
+	{
+		std::cout << "Column and per-cell decoding disagree" << std::endl;
+		return 1;
+	}
+
+	double namedMs = std::chrono::duration<double, std::milli>(namedTime).count() / iterations;
+	double cellMs = std::chrono::duration<double, std::milli>(cellTime).count() / iterations;
+	double columnMs = std::chrono::duration<double, std::milli>(columnTime).count() / iterations;
+
+	printf("%u rows, %u columns, %u iterations\n", rowCount, ColumnCount, iterations);
+	printf("by name:   %8.3f ms\n", namedMs);
+	printf("by handle: %8.3f ms (%.1fx)\n", cellMs, namedMs / cellMs);
+	printf("column:    %8.3f ms (%.1fx)\n", columnMs, namedMs / columnMs);
+	return 0;
+}
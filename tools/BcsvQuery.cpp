@@ -0,0 +1,170 @@
+// Headless query tool for extracted BCSV files.
+//
+// Usage: bcsvquery <file.bcsv> [--where <field><op><value>]... [--select <field>[,<field>...]] [--count]
+//
+// Operators are =, !=, <, <=, >, >= and min..max for an inclusive range, e.g.
+//   bcsvquery objinfo --where name=Kuribo --where pos_y=0..500 --select name,pos_x,pos_y,pos_z
+
+#include "io/BcsvQuery.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+static bool ParseNumber(const std::string& text, int32_t& intValue, float& floatValue, bool& isFloat)
+{
+	char* end = nullptr;
+
+	intValue = (int32_t)strtol(text.c_str(), &end, 0);
+	if (!text.empty() && *end == '\0')
+	{
+		isFloat = false;
+		floatValue = (float)intValue;
+		return true;
+	}
+
+	floatValue = strtof(text.c_str(), &end);
+	isFloat = true;
+	return !text.empty() && *end == '\0';
+}
+
+static bool AddPredicate(SBcsvQuery& query, const std::string& expression)
+{
+	// Longest operators first, so "<=" isn't taken for "<".
+	static const std::pair<const char*, EBcsvQueryOp> operators[] = {
+		{ "!=", EBcsvQueryOp::NotEqual },
+		{ "<=", EBcsvQueryOp::LessEqual },
+		{ ">=", EBcsvQueryOp::GreaterEqual },
+		{ "=", EBcsvQueryOp::Equal },
+		{ "<", EBcsvQueryOp::Less },
+		{ ">", EBcsvQueryOp::Greater },
+	};
+
+	for (const auto& [token, op] : operators)
+	{
+		size_t pos = expression.find(token);
+		if (pos == std::string::npos || pos == 0)
+			continue;
+
+		std::string field = expression.substr(0, pos);
+		std::string value = expression.substr(pos + strlen(token));
+
+		int32_t intMin, intMax;
+		float floatMin, floatMax;
+		bool minIsFloat, maxIsFloat;
+
+		size_t range = value.find("..");
+		if (op == EBcsvQueryOp::Equal && range != std::string::npos)
+		{
+			if (!ParseNumber(value.substr(0, range), intMin, floatMin, minIsFloat) || !ParseNumber(value.substr(range + 2), intMax, floatMax, maxIsFloat))
+				return false;
+
+			if (minIsFloat || maxIsFloat)
+				query.WhereBetween(field, floatMin, floatMax);
+			else
+				query.WhereBetween(field, intMin, intMax);
+		}
+		else if (ParseNumber(value, intMin, floatMin, minIsFloat))
+		{
+			if (minIsFloat)
+				query.Where(field, op, floatMin);
+			else
+				query.Where(field, op, intMin);
+		}
+		else
+		{
+			query.Where(field, op, std::string_view(value));
+		}
+
+		return true;
+	}
+
+	return false;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		std::cout << "Usage: bcsvquery <file.bcsv> [--where <field><op><value>]... [--select <field>[,<field>...]] [--count]" << std::endl;
+		return 1;
+	}
+
+	SBcsvQuery query;
+	bool countOnly = false;
+
+	for (int i = 2; i < argc; i++)
+	{
+		std::string arg = argv[i];
+
+		if (arg == "--count")
+		{
+			countOnly = true;
+		}
+		else if (arg == "--where" && i + 1 < argc)
+		{
+			if (!AddPredicate(query, argv[++i]))
+			{
+				std::cout << "Invalid predicate " << argv[i] << std::endl;
+				return 1;
+			}
+		}
+		else if (arg == "--select" && i + 1 < argc)
+		{
+			std::string fields = argv[++i];
+			for (size_t start = 0, end; start <= fields.size(); start = end + 1)
+			{
+				end = fields.find(',', start);
+				if (end == std::string::npos)
+					end = fields.size();
+				if (end > start)
+					query.Select(fields.substr(start, end - start));
+			}
+		}
+		else
+		{
+			std::cout << "Unknown argument " << arg << std::endl;
+			return 1;
+		}
+	}
+
+	std::ifstream file(argv[1], std::ios::binary);
+	if (!file)
+	{
+		std::cout << "Error opening file \"" << argv[1] << "\"" << std::endl;
+		return 1;
+	}
+
+	std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	SBcsvIO bcsv;
+	bStream::CMemoryStream stream(data.data(), data.size(), bStream::Endianess::Big, bStream::OpenMode::In);
+	if (!bcsv.LoadView(&stream))
+	{
+		std::cout << "Error loading BCSV \"" << argv[1] << "\"" << std::endl;
+		return 1;
+	}
+
+	SBcsvRowSet rows = query.Execute(bcsv);
+
+	if (countOnly)
+	{
+		std::cout << rows.Count() << std::endl;
+		return 0;
+	}
+
+	for (uint32_t row : rows.GetRows())
+	{
+		std::cout << row;
+		for (const std::string& field : query.GetProjection())
+			std::cout << '\t' << field << '=' << SBcsvQuery::FormatField(bcsv, row, field);
+		std::cout << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,154 @@
+// Benchmarks the in-tree Yaz0/Yay0 decoders against the libgctools ones.
+//
+// Usage: compressionbench [iterations]
+//
+// Builds a corpus of synthetic archive payloads from a few KB up to the size of a large planet
+// model, compresses each one in both formats, then decodes them through both decoders. Fails if
+// either decoder's output differs from the original data in any byte.
+
+#include "io/Compression.hpp"
+#include "archive.h"
+#include "compression.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Mixes the kinds of data found in archives: big-endian float tables, zero padding, short
+// repeating patterns, strings and incompressible noise standing in for compressed textures.
+static std::vector<uint8_t> BuildPayload(size_t size, uint32_t seed)
+{
+	std::mt19937 random(seed);
+	std::vector<uint8_t> data;
+	data.reserve(size);
+
+	static const char* strings[] = { "MarioFaceShipPlanet", "stageobjinfo", "ObjInfo", "CommonPathInfo", "GeneralPos" };
+
+	while (data.size() < size)
+	{
+		size_t segment = std::min<size_t>(256 + random() % 8192, size - data.size());
+
+		switch (random() % 5)
+		{
+			case 0:
+			{
+				float value = (float)(random() % 10000) / 10.0f;
+				for (size_t i = 0; i + 4 <= segment; i += 4)
+				{
+					value += (float)(random() % 16) * 0.25f;
+					uint32_t bits;
+					memcpy(&bits, &value, sizeof(bits));
+					for (int shift = 24; shift >= 0; shift -= 8)
+						data.push_back((uint8_t)(bits >> shift));
+				}
+				break;
+			}
+			case 1:
+				data.insert(data.end(), segment, 0);
+				break;
+			case 2:
+			{
+				uint8_t pattern[8];
+				size_t period = 2 + random() % 7;
+				for (size_t i = 0; i < period; i++)
+					pattern[i] = (uint8_t)random();
+				for (size_t i = 0; i < segment; i++)
+					data.push_back(pattern[i % period]);
+				break;
+			}
+			case 3:
+				for (size_t i = 0; i < segment;)
+				{
+					const char* str = strings[random() % 5];
+					size_t length = strlen(str) + 1;
+					data.insert(data.end(), str, str + length);
+					i += length;
+				}
+				break;
+			default:
+				for (size_t i = 0; i < segment; i++)
+					data.push_back((uint8_t)random());
+				break;
+		}
+	}
+
+	data.resize(size);
+	return data;
+}
+
+template<typename F>
+static double TimeDecode(uint32_t iterations, F&& decode)
+{
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < iterations; i++)
+		decode();
+
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+int main(int argc, char* argv[])
+{
+	uint32_t iterations = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 0) : 5;
+	if (iterations == 0)
+	{
+		std::cout << "Usage: compressionbench [iterations]" << std::endl;
+		return 1;
+	}
+
+	GCcontext context;
+	if (gcInitContext(&context) != GC_ERROR_SUCCESS)
+	{
+		std::cout << "Error initing libgctools context" << std::endl;
+		return 1;
+	}
+
+	static const size_t corpusSizes[] = { 16 * 1024, 256 * 1024, 2 * 1024 * 1024, 8 * 1024 * 1024, 24 * 1024 * 1024 };
+	bool mismatch = false;
+
+	printf("%-6s %10s %10s %12s %12s %8s\n", "format", "size", "packed", "in-tree ms", "gctools ms", "speedup");
+
+	for (size_t sizeIndex = 0; sizeIndex < sizeof(corpusSizes) / sizeof(corpusSizes[0]); sizeIndex++)
+	{
+		std::vector<uint8_t> original = BuildPayload(corpusSizes[sizeIndex], (uint32_t)sizeIndex + 1);
+
+		for (ECompressionFormat format : { ECompressionFormat::Yaz0, ECompressionFormat::Yay0 })
+		{
+			bool yay0 = format == ECompressionFormat::Yay0;
+
+			std::vector<uint8_t> packed;
+			SCompression::Compress(format, original.data(), original.size(), packed);
+
+			std::vector<uint8_t> inTree(original.size());
+			std::vector<uint8_t> gctools(original.size());
+
+			bool decoded = true;
+			double inTreeMs = TimeDecode(iterations, [&]() {
+				decoded &= yay0 ? SCompression::Yay0Decompress(packed.data(), packed.size(), inTree.data(), inTree.size())
+				                : SCompression::Yaz0Decompress(packed.data(), packed.size(), inTree.data(), inTree.size());
+			});
+
+			double gctoolsMs = TimeDecode(iterations, [&]() {
+				if (yay0)
+					gcYay0Decompress(&context, packed.data(), gctools.data(), gctools.size(), 0);
+				else
+					gcYaz0Decompress(&context, packed.data(), gctools.data(), gctools.size(), 0);
+			});
+
+			const char* formatName = yay0 ? "Yay0" : "Yaz0";
+			printf("%-6s %10zu %10zu %12.3f %12.3f %7.1fx\n", formatName, original.size(), packed.size(), inTreeMs, gctoolsMs, gctoolsMs / inTreeMs);
+
+			if (!decoded || inTree != original || gctools != original)
+			{
+				printf("%s output differs for the %zu byte payload (in-tree %s, libgctools %s)\n", formatName, original.size(),
+					decoded && inTree == original ? "ok" : "wrong", gctools == original ? "ok" : "wrong");
+				mismatch = true;
+			}
+		}
+	}
+
+	return mismatch ? 1 : 0;
+}